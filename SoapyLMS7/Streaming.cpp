@@ -12,6 +12,7 @@
 #include <thread>
 #include <iostream>
 #include <algorithm> //min/max
+#include <sstream>
 #include "Logger.h"
 #include "Streamer.h"
 
@@ -23,6 +24,7 @@ using namespace lime;
 struct IConnectionStream
 {
     std::vector<StreamChannel*> streamID;
+    std::vector<size_t> buffIndex; //index of the first buffer of each streamID
     int direction;
     size_t elemSize;
     size_t elemMTU;
@@ -44,6 +46,7 @@ std::vector<std::string> SoapyLMS7::getStreamFormats(const int direction, const
     formats.push_back(SOAPY_SDR_CF32);
     formats.push_back(SOAPY_SDR_CS12);
     formats.push_back(SOAPY_SDR_CS16);
+    formats.push_back(SOAPY_SDR_CS8);
     return formats;
 }
 
@@ -79,8 +82,10 @@ SoapySDR::ArgInfoList SoapyLMS7::getStreamArgsInfo(const int direction, const si
         info.type = SoapySDR::ArgInfo::STRING;
         info.options.push_back(SOAPY_SDR_CS16);
         info.options.push_back(SOAPY_SDR_CS12);
+        info.options.push_back(SOAPY_SDR_CS8);
         info.optionNames.push_back("Complex int16");
         info.optionNames.push_back("Complex int12");
+        info.optionNames.push_back("Complex int8, requires gateware support");
         argInfos.push_back(info);
     }
 
@@ -106,6 +111,178 @@ SoapySDR::ArgInfoList SoapyLMS7::getStreamArgsInfo(const int direction, const si
         argInfos.push_back(info);
     }
 
+    //worker thread settings
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "";
+        info.key = "threadCpus";
+        info.name = "Thread CPUs";
+        info.description = "CPUs the stream worker thread may run on, e.g. \"2,3\" or \"4-7\".";
+        info.type = SoapySDR::ArgInfo::STRING;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "default";
+        info.key = "threadPolicy";
+        info.name = "Thread Policy";
+        info.description = "Scheduling policy of the stream worker thread.";
+        info.type = SoapySDR::ArgInfo::STRING;
+        info.options.push_back("default");
+        info.options.push_back("fifo");
+        info.options.push_back("rr");
+        info.optionNames.push_back("Default");
+        info.optionNames.push_back("SCHED_FIFO");
+        info.optionNames.push_back("SCHED_RR");
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "threadPriority";
+        info.name = "Thread Priority";
+        info.description = "Priority of the stream worker thread for real-time policies.";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "";
+        info.key = "threadName";
+        info.name = "Thread Name";
+        info.description = "Name of the stream worker thread.";
+        info.type = SoapySDR::ArgInfo::STRING;
+        argInfos.push_back(info);
+    }
+
+    //FIFO memory options
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "hugePages";
+        info.name = "Huge Pages";
+        info.description = "Back stream buffer with huge pages.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "lockMemory";
+        info.name = "Lock Memory";
+        info.description = "Lock stream buffer in RAM.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "autoTune";
+        info.name = "Auto Tune";
+        info.description = "Adjust link transfer size and count while streaming.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "linkTransfers";
+        info.name = "Link Transfers";
+        info.description = "Number of link transfers kept in flight, 0 for default.";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "linkTransferSize";
+        info.name = "Link Transfer Size";
+        info.description = "Size of a link transfer in bytes, at most 1 MiB, 0 for default.";
+        info.units = "bytes";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+
+    //pipelined Rx
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "pipelined";
+        info.name = "Pipelined Rx";
+        info.description = "Parse received packets in a separate thread from link transfers.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+
+    //joint FIFO for channel pairs
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "jointChannels";
+        info.name = "Joint Channels";
+        info.description = "Stream both channels of a chip through one FIFO, keeping them aligned.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+
+    //Rx sample loss handling
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "dropOldest";
+        info.key = "overflowPolicy";
+        info.name = "Overflow Policy";
+        info.description = "Samples to drop when stream buffer is full, lost ranges are reported by readStreamStatus().";
+        info.type = SoapySDR::ArgInfo::STRING;
+        info.options.push_back("dropOldest");
+        info.options.push_back("dropNewest");
+        info.options.push_back("block");
+        info.optionNames.push_back("Drop oldest");
+        info.optionNames.push_back("Drop newest");
+        info.optionNames.push_back("Block, then drop newest");
+        argInfos.push_back(info);
+    }
+    if (direction == SOAPY_SDR_RX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "concat";
+        info.key = "gapHandling";
+        info.name = "Gap Handling";
+        info.description = "Handling of lost samples in readStream().";
+        info.type = SoapySDR::ArgInfo::STRING;
+        info.options.push_back("concat");
+        info.options.push_back("zeroFill");
+        info.options.push_back("split");
+        info.optionNames.push_back("Concatenate");
+        info.optionNames.push_back("Fill with zeros");
+        info.optionNames.push_back("End read at gap");
+        argInfos.push_back(info);
+    }
+
+    //Tx burst scheduling
+    if (direction == SOAPY_SDR_TX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "burstLeadTime";
+        info.name = "Burst Lead Time";
+        info.description = "Minimum time (s) ahead of hardware time for a burst to be on time.";
+        info.units = "s";
+        info.type = SoapySDR::ArgInfo::FLOAT;
+        argInfos.push_back(info);
+    }
+    if (direction == SOAPY_SDR_TX)
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "dropLateBursts";
+        info.name = "Drop Late Bursts";
+        info.description = "Drop late bursts instead of only reporting them.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+
     return argInfos;
 }
 
@@ -128,18 +305,83 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
 
     StreamConfig config;
     config.align = args.count("alignPhase") != 0 and args.at("alignPhase") == "true";
+    config.pipelined = args.count("pipelined") != 0 and args.at("pipelined") == "true";
+    config.hugePages = args.count("hugePages") != 0 and args.at("hugePages") == "true";
+    config.lockMemory = args.count("lockMemory") != 0 and args.at("lockMemory") == "true";
+    config.autoTune = args.count("autoTune") != 0 and args.at("autoTune") == "true";
+    config.dropLateBursts = args.count("dropLateBursts") != 0 and args.at("dropLateBursts") == "true";
+    if (args.count("burstLeadTime") != 0)
+        config.burstLeadTime = std::stod(args.at("burstLeadTime"));
+
+    //optional worker thread settings
+    if (args.count("threadCpus") != 0)
+    {
+        std::stringstream ss(args.at("threadCpus"));
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            if (item.empty())
+                continue;
+            const auto dash = item.find('-');
+            const int first = std::stoi(item.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash+1));
+            for (int cpu = first; cpu <= last; ++cpu)
+                config.threadCpus.push_back(cpu);
+        }
+    }
+    if (args.count("threadPolicy") != 0)
+    {
+        const std::string policy = args.at("threadPolicy");
+        if (policy == "fifo") config.threadPolicy = StreamConfig::THREAD_FIFO;
+        else if (policy == "rr") config.threadPolicy = StreamConfig::THREAD_RR;
+        else if (policy == "default") config.threadPolicy = StreamConfig::THREAD_DEFAULT;
+        else throw std::runtime_error("SoapyLMS7::setupStream(threadPolicy="+policy+") unsupported policy");
+    }
+    if (args.count("threadPriority") != 0)
+        config.threadPriority = std::stoi(args.at("threadPriority"));
+    if (args.count("threadName") != 0)
+        config.threadName = args.at("threadName");
+    if (args.count("overflowPolicy") != 0)
+    {
+        const std::string &policy = args.at("overflowPolicy");
+        if (policy == "dropOldest") config.overflowPolicy = StreamConfig::OVERFLOW_DROP_OLDEST;
+        else if (policy == "dropNewest") config.overflowPolicy = StreamConfig::OVERFLOW_DROP_NEWEST;
+        else if (policy == "block") config.overflowPolicy = StreamConfig::OVERFLOW_BLOCK;
+        else throw std::runtime_error("SoapyLMS7::setupStream(overflowPolicy="+policy+") unsupported policy");
+    }
+    if (args.count("gapHandling") != 0)
+    {
+        const std::string &gapHandling = args.at("gapHandling");
+        if (gapHandling == "concat") config.gapHandling = StreamConfig::GAP_CONCATENATE;
+        else if (gapHandling == "zeroFill") config.gapHandling = StreamConfig::GAP_ZERO_FILL;
+        else if (gapHandling == "split") config.gapHandling = StreamConfig::GAP_SPLIT;
+        else throw std::runtime_error("SoapyLMS7::setupStream(gapHandling="+gapHandling+") unsupported gap handling");
+    }
+    if (args.count("linkFormat") != 0)
+    {
+        const std::string &linkFormat = args.at("linkFormat");
+        if (linkFormat == SOAPY_SDR_CS16) config.linkFormat = StreamConfig::FMT_INT16;
+        else if (linkFormat == SOAPY_SDR_CS12) config.linkFormat = StreamConfig::FMT_INT12;
+        else if (linkFormat == SOAPY_SDR_CS8) config.linkFormat = StreamConfig::FMT_INT8;
+        else throw std::runtime_error("SoapyLMS7::setupStream(linkFormat="+linkFormat+") unsupported link format");
+    }
     config.isTx = (direction == SOAPY_SDR_TX);
     config.performanceLatency = 0.5;
     config.bufferLength = 0; //auto
 
+    const bool joint = args.count("jointChannels") != 0 and args.at("jointChannels") == "true";
+
     //default to channel 0, if none were specified
     const std::vector<size_t> &channelIDs = channels.empty() ? std::vector<size_t>{0} : channels;
     for(size_t i=0; i<channelIDs.size(); ++i)
     {
         config.channelID = channelIDs[i];
+        //both channels of a chip in order are streamed through joint FIFO
+        config.jointChannels = joint and channelIDs[i]%2 == 0 and i+1 < channelIDs.size() and channelIDs[i+1] == channelIDs[i]+1;
         if (format == SOAPY_SDR_CF32) config.format = StreamConfig::FMT_FLOAT32;
         else if (format == SOAPY_SDR_CS16) config.format = StreamConfig::FMT_INT16;
         else if (format == SOAPY_SDR_CS12) config.format = StreamConfig::FMT_INT12;
+        else if (format == SOAPY_SDR_CS8) config.format = StreamConfig::FMT_INT8;
         else throw std::runtime_error("SoapyLMS7::setupStream(format="+format+") unsupported format");
 
         //optional buffer length if specified (from device args)
@@ -155,6 +397,16 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
             config.bufferLength = std::stoul(args.at("bufferLength"));
         }
 
+        //optional link transfers in flight and transfer size (stream args take precedent over device args)
+        if (args.count("linkTransfers") != 0)
+            config.linkTransfers = std::stoul(args.at("linkTransfers"));
+        else if (_deviceArgs.count("linkTransfers") != 0)
+            config.linkTransfers = std::stoul(_deviceArgs.at("linkTransfers"));
+        if (args.count("linkTransferSize") != 0)
+            config.linkTransferSize = std::stoul(args.at("linkTransferSize"));
+        else if (_deviceArgs.count("linkTransferSize") != 0)
+            config.linkTransferSize = std::stoul(_deviceArgs.at("linkTransferSize"));
+
         //optional packets latency, 1-maximum throughput, 0-lowest latency
         if (args.count("latency") != 0)
         {
@@ -170,7 +422,9 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
         if (streamID == 0)
             throw std::runtime_error("SoapyLMS7::setupStream() failed: " + std::string(GetLastErrorMessage()));
         stream->streamID.push_back(streamID);
+        stream->buffIndex.push_back(i);
         stream->elemMTU = streamID->GetStreamSize();
+        if (config.jointChannels) ++i;
     }
 
     //calibrate these channels when activated
@@ -293,7 +547,15 @@ int SoapyLMS7::_readStreamAligned(
         const uint64_t expectedTime(requestTime + N);
         if (numElems <= N)
             continue;
-        int status = streamID[i]->Read(buffs[i]+(elemSize*N), numElems-N,&md, timeoutMs);
+        //joint streams fill buffers of both channels at once
+        const size_t chCount = streamID[i]->GetChannelCount();
+        char *chBuffs[2];
+        for (size_t c = 0; c < chCount; c++)
+            chBuffs[c] = buffs[stream->buffIndex[i]+c]+(elemSize*N);
+        //with request time, samples before expected time are dropped inside FIFO
+        md.flags = requestTime != 0 ? RingFIFO::SYNC_TIMESTAMP : 0;
+        md.timestamp = expectedTime;
+        int status = streamID[i]->ReadMulti((void * const *)chBuffs, numElems-N,&md, timeoutMs);
         if (status == 0) return SOAPY_SDR_TIMEOUT;
         if (status < 0) return SOAPY_SDR_STREAM_ERROR;
 
@@ -308,28 +570,28 @@ int SoapyLMS7::_readStreamAligned(
         //good contiguous read, read again for remainder
         if (expectedTime == md.timestamp) continue;
 
-        //request time is later, fast forward buffer
+        //FIFO never returns samples before expected time
         if (md.timestamp < expectedTime)
         {
-            if (prevN != 0)
-            {
-                SoapySDR::log(SOAPY_SDR_ERROR, "readStream() experienced non-monotonic timestamp");
-                return SOAPY_SDR_CORRUPTION;
-            }
-            fastForward(buffs[i], N, elemSize, md.timestamp, requestTime);
-            if (i == 0 and N != 0) numElems = N; //match size on other channels
-            continue; //read again into the remaining buffer
+            SoapySDR::log(SOAPY_SDR_ERROR, "readStream() experienced non-monotonic timestamp");
+            return SOAPY_SDR_CORRUPTION;
         }
 
         //overflow in the middle of a contiguous buffer
         //fast-forward all prior channels and restart loop
         if (md.timestamp > expectedTime)
         {
-            for (size_t j = 0; j < i; j++)
+            for (size_t j = 0; j <= i; j++)
             {
-                fastForward(buffs[j], numWritten[j], elemSize, requestTime, md.timestamp);
+                const uint64_t headTime = (j == i) ? md.timestamp-prevN : requestTime;
+                size_t numKept = 0;
+                for (size_t c = 0; c < streamID[j]->GetChannelCount(); c++)
+                {
+                    numKept = numWritten[j];
+                    fastForward(buffs[stream->buffIndex[j]+c], numKept, elemSize, headTime, md.timestamp);
+                }
+                numWritten[j] = numKept;
             }
-            fastForward(buffs[i], N, elemSize, md.timestamp-prevN, md.timestamp);
             i = 0; //start over at ch0
         }
 
@@ -374,6 +636,8 @@ int SoapyLMS7::readStream(
     }
 
     StreamChannel::Metadata metadata;
+    metadata.flags = 0;
+    metadata.timestamp = 0;
     const uint64_t cmdTicks = ((icstream->flags & SOAPY_SDR_HAS_TIME) != 0)?SoapySDR::timeNsToTicks(icstream->timeNs, sampleRate[SOAPY_SDR_RX]):0;
     int status = _readStreamAligned(icstream, (char * const *)buffs, numElems, cmdTicks, metadata, timeoutUs/1000);
     if (status < 0) return status;
@@ -446,8 +710,8 @@ int SoapyLMS7::writeStream(
     metadata.flags = (flags & SOAPY_SDR_HAS_TIME) ? lime::RingFIFO::SYNC_TIMESTAMP : 0;
     metadata.flags |= (flags & SOAPY_SDR_END_BURST) ? lime::RingFIFO::END_BURST : 0;
 
-    //write the 0th channel: get number of samples written
-    int status = streamID[0]->Write(buffs[0], numElems, &metadata, timeoutUs/1000);
+    //write the 0th stream: get number of samples written
+    int status = streamID[0]->WriteMulti(buffs, numElems, &metadata, timeoutUs/1000);
     if (status == 0) return SOAPY_SDR_TIMEOUT;
     if (status < 0) return SOAPY_SDR_STREAM_ERROR;
 
@@ -456,7 +720,7 @@ int SoapyLMS7::writeStream(
     //or there is an unknown internal issue with the stream fifo
     for (size_t i = 1; i < streamID.size(); i++)
     {
-        int status_i = streamID[i]->Write(buffs[i], status, &metadata, 1000/*1s*/);
+        int status_i = streamID[i]->WriteMulti(&buffs[icstream->buffIndex[i]], status, &metadata, 1000/*1s*/);
         if (status_i != status)
         {
             SoapySDR::logf(SOAPY_SDR_ERROR, "Multi-channel stream alignment failed!");
@@ -484,6 +748,29 @@ int SoapyLMS7::readStreamStatus(
     auto start = std::chrono::high_resolution_clock::now();
     while (1)
     {
+        //Tx burst events are reported first, late bursts as time errors
+        for(auto i : streamID)
+        {
+            lime::StreamChannel::BurstEvent event;
+            if (i->ReadBurstEvent(&event, 0) != 1)
+                continue;
+            timeNs = SoapySDR::ticksToTimeNs(event.timestamp, sampleRate[SOAPY_SDR_TX]);
+            flags |= SOAPY_SDR_HAS_TIME;
+            if (event.type == lime::StreamChannel::BurstEvent::BURST_LATE)
+                return SOAPY_SDR_TIME_ERROR;
+            flags |= SOAPY_SDR_END_BURST;
+            return 0;
+        }
+        //Rx gaps are reported at their start, link loss as time error, host overflow as overflow
+        for(auto i : streamID)
+        {
+            lime::StreamChannel::Gap gap;
+            if (i->ReadGap(&gap, 0) != 1)
+                continue;
+            timeNs = SoapySDR::ticksToTimeNs(gap.timestamp, sampleRate[SOAPY_SDR_RX]);
+            flags |= SOAPY_SDR_HAS_TIME;
+            return gap.cause == lime::StreamChannel::Gap::GAP_LINK ? SOAPY_SDR_TIME_ERROR : SOAPY_SDR_OVERFLOW;
+        }
         for(auto i : streamID)
         {
             metadata = i->GetInfo();
@@ -728,9 +728,11 @@ API_EXPORT int CALL_CONV LMS_SetupStream(lms_device_t *device, lms_stream_t *str
 
     lime::StreamConfig config;
     config.bufferLength = stream->fifoSize;
-    config.channelID = stream->channel;
+    config.channelID = stream->channel & 0xFFFF; //strip channel flags
     config.performanceLatency = stream->throughputVsLatency;
     config.align = stream->channel & LMS_ALIGN_CH_PHASE;
+    config.autoTune = stream->channel & LMS_STREAM_AUTO_TUNE;
+    config.jointChannels = stream->channel & LMS_STREAM_JOINT;
     switch(stream->dataFmt)
     {
         case lms_stream_t::LMS_FMT_F32:
@@ -742,10 +744,67 @@ API_EXPORT int CALL_CONV LMS_SetupStream(lms_device_t *device, lms_stream_t *str
         case lms_stream_t::LMS_FMT_I12:
             config.format = lime::StreamConfig::FMT_INT12;
             break;
+        case lms_stream_t::LMS_FMT_I16_PLANAR:
+            config.format = lime::StreamConfig::FMT_INT16_PLANAR;
+            break;
+        case lms_stream_t::LMS_FMT_F32_PLANAR:
+            config.format = lime::StreamConfig::FMT_FLOAT32_PLANAR;
+            break;
         default:
             config.format = lime::StreamConfig::FMT_FLOAT32;
     }
     config.isTx = stream->isTx;
+    if (stream->channel & LMS_STREAM_THREAD_CFG)
+    {
+        for (int i = 0; i < 64; ++i)
+            if (stream->threadCpuMask & (uint64_t(1) << i))
+                config.threadCpus.push_back(i);
+        switch(stream->threadPolicy)
+        {
+            case lms_stream_t::LMS_SCHED_FIFO:
+                config.threadPolicy = lime::StreamConfig::THREAD_FIFO;
+                break;
+            case lms_stream_t::LMS_SCHED_RR:
+                config.threadPolicy = lime::StreamConfig::THREAD_RR;
+                break;
+            default:
+                config.threadPolicy = lime::StreamConfig::THREAD_DEFAULT;
+        }
+        config.threadPriority = stream->threadPriority;
+        if (stream->threadName)
+            config.threadName = stream->threadName;
+    }
+    if (stream->channel & LMS_STREAM_BURST_CFG)
+    {
+        config.burstLeadTime = stream->burstLeadTime;
+        config.dropLateBursts = stream->dropLateBursts;
+    }
+    if (stream->channel & LMS_STREAM_EVENT_FD)
+        config.eventThreshold = stream->eventThreshold ? stream->eventThreshold : 1;
+    if (stream->channel & LMS_STREAM_GAP_SPLIT)
+        config.gapHandling = lime::StreamConfig::GAP_SPLIT;
+    else if (stream->channel & LMS_STREAM_GAP_ZERO_FILL)
+        config.gapHandling = lime::StreamConfig::GAP_ZERO_FILL;
+    if (stream->channel & LMS_STREAM_OVERFLOW_CFG)
+    {
+        switch(stream->overflowPolicy)
+        {
+            case lms_stream_t::LMS_OVERFLOW_DROP_NEWEST:
+                config.overflowPolicy = lime::StreamConfig::OVERFLOW_DROP_NEWEST;
+                break;
+            case lms_stream_t::LMS_OVERFLOW_BLOCK:
+                config.overflowPolicy = lime::StreamConfig::OVERFLOW_BLOCK;
+                break;
+            default:
+                config.overflowPolicy = lime::StreamConfig::OVERFLOW_DROP_OLDEST;
+        }
+        config.overflowBlockTime = stream->overflowBlockTime;
+    }
+    if (stream->channel & LMS_STREAM_LINK_CFG)
+    {
+        config.linkTransfers = stream->linkTransfers;
+        config.linkTransferSize = stream->linkTransferSize;
+    }
     stream->handle = size_t(lms->SetupStream(config));
     return stream->handle == 0 ? -1 : 0;
 }
@@ -798,11 +857,111 @@ API_EXPORT int CALL_CONV LMS_RecvStream(lms_stream_t *stream, void *samples, siz
     else metadata.timestamp = 0;
 
     int status = channel->Read(samples, sample_count, &metadata, timeout_ms);
+    if (meta)
+    {
+        meta->timestamp = metadata.timestamp;
+        meta->discontinuity = metadata.flags & lime::RingFIFO::DISCONTINUITY;
+    }
+    return status;
+}
+
+API_EXPORT int CALL_CONV LMS_RecvStreamMulti(lms_stream_t *stream, void **samples, size_t sample_count, lms_stream_meta_t *meta, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0 || samples==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Metadata metadata;
+    metadata.flags = 0;
+    if (meta)
+    {
+        metadata.flags |= meta->waitForTimestamp * lime::RingFIFO::SYNC_TIMESTAMP;
+        metadata.timestamp = meta->timestamp;
+    }
+    else metadata.timestamp = 0;
+
+    int status = channel->ReadMulti(samples, sample_count, &metadata, timeout_ms);
+    if (meta)
+    {
+        meta->timestamp = metadata.timestamp;
+        meta->discontinuity = metadata.flags & lime::RingFIFO::DISCONTINUITY;
+    }
+    return status;
+}
+
+API_EXPORT int CALL_CONV LMS_AttachStreamReader(lms_stream_t *stream, bool dropWhenLagging)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    return channel->AttachReader(dropWhenLagging);
+}
+
+API_EXPORT int CALL_CONV LMS_DetachStreamReader(lms_stream_t *stream, int reader)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    return channel->DetachReader(reader);
+}
+
+API_EXPORT int CALL_CONV LMS_RecvStreamReader(lms_stream_t *stream, int reader, void **samples, size_t sample_count, lms_stream_meta_t *meta, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0 || samples==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Metadata metadata;
+    metadata.flags = 0;
+    metadata.timestamp = 0;
+
+    int status = channel->ReadMultiFrom(reader, samples, sample_count, &metadata, timeout_ms);
+    if (meta)
+    {
+        meta->timestamp = metadata.timestamp;
+        meta->discontinuity = metadata.flags & lime::RingFIFO::DISCONTINUITY;
+    }
+    return status;
+}
+
+API_EXPORT int CALL_CONV LMS_GetStreamReaderStatus(lms_stream_t *stream, int reader, lms_stream_status_t* status)
+{
+    if (stream==nullptr || stream->handle==0 || status==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::ReaderInfo info;
+    if (channel->GetReaderInfo(reader, &info) != 0)
+        return -1;
+    //stream counters are left for LMS_GetStreamStatus()
+    memset(status, 0, sizeof(lms_stream_status_t));
+    status->active = channel->IsActive() && !info.detached;
+    status->fifoFilledCount = info.lag;
+    status->fifoSize = channel->fifo->GetInfo(false).size;
+    status->overrun = info.overflow;
+    status->underrun = info.underflow;
+    return LMS_SUCCESS;
+}
+
+API_EXPORT int CALL_CONV LMS_RecvStreamAcquire(lms_stream_t *stream, const int16_t **samples, int *handle, lms_stream_meta_t *meta, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0 || samples==nullptr || handle==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Metadata metadata;
+    metadata.flags = 0;
+    metadata.timestamp = 0;
+
+    int status = channel->AcquireReadBuffer((const lime::complex16_t**)samples, &metadata, handle, timeout_ms);
     if (meta)
         meta->timestamp = metadata.timestamp;
     return status;
 }
 
+API_EXPORT int CALL_CONV LMS_RecvStreamRelease(lms_stream_t *stream, int handle)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    return reinterpret_cast<lime::StreamChannel*>(stream->handle)->ReleaseReadBuffer(handle);
+}
+
 API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream, const void *samples, size_t sample_count, const lms_stream_meta_t *meta, unsigned timeout_ms)
 {
     if (stream==nullptr || stream->handle==0)
@@ -821,6 +980,50 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream, const void *sample
     return channel->Write(samples, sample_count, &metadata, timeout_ms);
 }
 
+API_EXPORT int CALL_CONV LMS_SendStreamMulti(lms_stream_t *stream, const void **samples, size_t sample_count, const lms_stream_meta_t *meta, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0 || samples==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Metadata metadata;
+    metadata.flags = 0;
+    if (meta)
+    {
+        metadata.flags |= meta->waitForTimestamp * lime::RingFIFO::SYNC_TIMESTAMP;
+        metadata.flags |= meta->flushPartialPacket * lime::RingFIFO::END_BURST;
+        metadata.timestamp = meta->timestamp;
+    }
+    else metadata.timestamp = 0;
+
+    return channel->WriteMulti(samples, sample_count, &metadata, timeout_ms);
+}
+
+API_EXPORT int CALL_CONV LMS_SendStreamAcquire(lms_stream_t *stream, int16_t **samples, int *handle, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0 || samples==nullptr || handle==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    return channel->AcquireWriteBuffer((lime::complex16_t**)samples, handle, timeout_ms);
+}
+
+API_EXPORT int CALL_CONV LMS_SendStreamCommit(lms_stream_t *stream, int handle, size_t sample_count, const lms_stream_meta_t *meta)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Metadata metadata;
+    metadata.flags = 0;
+    if (meta)
+    {
+        metadata.flags |= meta->waitForTimestamp * lime::RingFIFO::SYNC_TIMESTAMP;
+        metadata.flags |= meta->flushPartialPacket * lime::RingFIFO::END_BURST;
+        metadata.timestamp = meta->timestamp;
+    }
+    else metadata.timestamp = 0;
+
+    return channel->CommitWriteBuffer(handle, sample_count, &metadata);
+}
+
 API_EXPORT int CALL_CONV LMS_UploadWFM(lms_device_t *device,
                                          const void **samples, uint8_t chCount,
                                          size_t sample_count, int format)
@@ -878,9 +1081,68 @@ API_EXPORT int CALL_CONV LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_st
     status->overrun = info.overrun;
     status->underrun = info.underrun;
     status->timestamp = info.timestamp;
+    status->gapCount = info.gapsCount;
     return LMS_SUCCESS;
 }
 
+API_EXPORT int CALL_CONV LMS_GetStreamFd(lms_stream_t *stream)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    return channel->GetEventFd();
+}
+
+API_EXPORT int CALL_CONV LMS_GetStreamGap(lms_stream_t *stream, lms_stream_gap_t *gap, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0 || gap==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Gap lost;
+    int ret = channel->ReadGap(&lost, timeout_ms);
+    if (ret != 1)
+        return ret;
+    gap->timestamp = lost.timestamp;
+    gap->sampleCount = lost.samplesCount;
+    gap->cause = lost.cause == lime::StreamChannel::Gap::GAP_LINK ? lms_stream_gap_t::LMS_GAP_LINK : lms_stream_gap_t::LMS_GAP_OVERFLOW;
+    return 1;
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamCallback(lms_stream_t *stream, lms_stream_cb_t callback, void *userData)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    if (callback == nullptr)
+        return channel->SetCallback(nullptr);
+    return channel->SetCallback([stream, callback, userData](const lime::StreamChannel::PacketBatch& batch){
+        lms_stream_batch_t b;
+        b.packetCount = batch.packetsCount;
+        b.samples = (const int16_t* const*)batch.samples;
+        b.sampleCount = batch.samplesCount;
+        b.timestamp = batch.timestamps;
+        b.channelStride = batch.channelStride;
+        callback(stream, &b, userData);
+    });
+}
+
+API_EXPORT int CALL_CONV LMS_GetTxBurstEvent(lms_stream_t *stream, lms_burst_event_t *event, unsigned timeout_ms)
+{
+    assert(stream != nullptr);
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    if(channel == nullptr || event == nullptr)
+        return -1;
+    lime::StreamChannel::BurstEvent burst;
+    int ret = channel->ReadBurstEvent(&burst, timeout_ms);
+    if (ret != 1)
+        return ret;
+    event->type = burst.type == lime::StreamChannel::BurstEvent::BURST_LATE ? lms_burst_event_t::LMS_BURST_LATE : lms_burst_event_t::LMS_BURST_ACK;
+    event->timestamp = burst.timestamp;
+    event->time = burst.time;
+    event->dropped = burst.dropped;
+    return 1;
+}
+
 API_EXPORT const lms_dev_info_t* CALL_CONV LMS_GetDeviceInfo(lms_device_t *device)
 {
     lime::LMS7_Device* lms = CheckDevice(device);
@@ -1787,7 +1787,7 @@ int LMS7_Device::UploadWFM(const void **samples, uint8_t chCount, int sample_cou
 
 lime::StreamChannel* LMS7_Device::SetupStream(const lime::StreamConfig &config)
 {
-    if (config.channelID >= GetNumChannels())
+    if (config.channelID + (config.jointChannels ? 1 : 0) >= GetNumChannels())
         return nullptr;
     if (!connection)
         return nullptr;
@@ -6,6 +6,8 @@
 
 #include "ConnectionFT601.h"
 #include <cstring>
+#include <algorithm>
+#include <stdlib.h>
 #include <iostream>
 #include <vector>
 
@@ -24,6 +26,9 @@ const int ConnectionFT601::ctrlWrEp = 0x02;
 const int ConnectionFT601::ctrlRdEp = 0x82;
 
 ConnectionFT601::ConnectionFT601(void *arg)
+#ifdef __unix__
+    : readCompletions(USB_MAX_CONTEXTS), sendCompletions(USB_MAX_CONTEXTS)
+#endif
 {
     isConnected = false;
 #ifndef __unix__
@@ -38,6 +43,9 @@ ConnectionFT601::ConnectionFT601(void *arg)
 /**	@brief Initializes port type and object necessary to communicate to usb device.
 */
 ConnectionFT601::ConnectionFT601(void *arg, const ConnectionHandle &handle)
+#ifdef __unix__
+    : readCompletions(USB_MAX_CONTEXTS), sendCompletions(USB_MAX_CONTEXTS)
+#endif
 {
     isConnected = false;
     int pid = -1;
@@ -367,7 +375,6 @@ int ConnectionFT601::Read(unsigned char *buffer, const int length, int timeout_m
 static void callback_libusbtransfer(libusb_transfer *trans)
 {
     ConnectionFT601::USBTransferContext *context = reinterpret_cast<ConnectionFT601::USBTransferContext*>(trans->user_data);
-    std::unique_lock<std::mutex> lck(context->transferLock);
     switch(trans->status)
     {
         case LIBUSB_TRANSFER_CANCELLED:
@@ -397,14 +404,83 @@ static void callback_libusbtransfer(libusb_transfer *trans)
             lime::error("transfer no device");
             break;
     }
-    lck.unlock();
-    context->cv.notify_one();
+    if (context->done.load())
+        context->completions->push(context->handle);
 }
+
+/** @brief Waits for transfer of context to complete.
+    Wakes up when any transfer completes and takes all completed handles from
+    the queue at once, so that waiting for them afterwards does not block.
+*/
+template<class Context>
+static bool WaitForCompletion(Context& context, MPSCQueue<int>& completions, unsigned int timeout_ms)
+{
+    const auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout_ms);
+    int handle;
+    while (context.done.load() == false)
+    {
+        const auto now = chrono::steady_clock::now();
+        if (now >= deadline)
+            return false;
+        const auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - now).count();
+        if (completions.pop(handle, std::max<long>(1, remaining)))
+            while (completions.pop(handle, 0));
+    }
+    return true;
+}
+#endif
+
+/** @brief Allocates stream buffer in usbfs DMA memory, so that kernel transfers
+    samples directly to/from it without copying. Falls back to page aligned memory
+    if DMA memory is not available.
+*/
+char* ConnectionFT601::AllocateStreamBuffer(size_t length)
+{
+#ifdef __unix__
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+    unsigned char* devMem = libusb_dev_mem_alloc(dev_handle, length);
+    if (devMem)
+    {
+        std::lock_guard<std::mutex> lock(mExtraUsbMutex);
+        devMemBuffers.insert((char*)devMem);
+        return (char*)devMem;
+    }
+    lime::debug("USB DMA memory is not available, using regular stream buffers");
+#endif
+    void* aligned = nullptr;
+    if (posix_memalign(&aligned, 4096, length) != 0)
+        return nullptr;
+    return (char*)aligned;
+#else
+    return nullptr;
 #endif
+}
+
+void ConnectionFT601::FreeStreamBuffer(char* buffer, size_t length)
+{
+#ifdef __unix__
+    {
+        std::lock_guard<std::mutex> lock(mExtraUsbMutex);
+        if (devMemBuffers.erase(buffer))
+        {
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+            libusb_dev_mem_free(dev_handle, (unsigned char*)buffer, length);
+#endif
+            return;
+        }
+    }
+    free(buffer);
+#endif
+}
 
 int ConnectionFT601::GetBuffersCount() const
 {
-    return USB_MAX_CONTEXTS;
+    return USB_DEFAULT_CONTEXTS;
+}
+
+int ConnectionFT601::CheckBuffersCount(int count) const
+{
+    return std::max(1, std::min(count, int(USB_MAX_CONTEXTS)));
 }
 
 int ConnectionFT601::CheckStreamSize(int size)const
@@ -412,6 +488,21 @@ int ConnectionFT601::CheckStreamSize(int size)const
     return size;
 }
 
+/** @brief Returns index of unused transfer context, adds new context to the pool if all are in use
+    @return context index, -1 if pool already has maxCount contexts
+*/
+template<class Context>
+static int GetFreeContext(std::vector<std::unique_ptr<Context>>& pool, const int maxCount)
+{
+    for (size_t i = 0; i < pool.size(); ++i)
+        if (!pool[i]->used)
+            return i;
+    if ((int)pool.size() >= maxCount)
+        return -1;
+    pool.emplace_back(new Context());
+    return pool.size()-1;
+}
+
 /**
 @brief Starts asynchronous data reading from board
 @param *buffer buffer where to store received data
@@ -420,45 +511,37 @@ int ConnectionFT601::CheckStreamSize(int size)const
 */
 int ConnectionFT601::BeginDataReading(char *buffer, uint32_t length, int ep)
 {
-    int i = 0;
-    bool contextFound = false;
-    //find not used context
-    for(i = 0; i<USB_MAX_CONTEXTS; i++)
-    {
-        if(!contexts[i].used)
-        {
-            contextFound = true;
-            break;
-        }
-    }
-    if(!contextFound)
+    const int i = GetFreeContext(contexts, USB_MAX_CONTEXTS);
+    if(i < 0)
     {
         lime::error("No contexts left for reading data");
         return -1;
     }
-    contexts[i].used = true;
+    contexts[i]->used = true;
 
 #ifndef __unix__
-    FT_InitializeOverlapped(mFTHandle, &contexts[i].inOvLap);
+    FT_InitializeOverlapped(mFTHandle, &contexts[i]->inOvLap);
 	ULONG ulActual;
     FT_STATUS ftStatus = FT_OK;
-    ftStatus = FT_ReadPipe(mFTHandle, streamRdEp, (unsigned char*)buffer, length, &ulActual, &contexts[i].inOvLap);
+    ftStatus = FT_ReadPipe(mFTHandle, streamRdEp, (unsigned char*)buffer, length, &ulActual, &contexts[i]->inOvLap);
     if (ftStatus != FT_IO_PENDING)
     {
         lime::error("ERROR BEGIN DATA READING %d", ftStatus);
-        contexts[i].used = false;
+        contexts[i]->used = false;
         return -1;
     }
 #else
-    libusb_transfer *tr = contexts[i].transfer;
-    libusb_fill_bulk_transfer(tr, dev_handle, streamRdEp, (unsigned char*)buffer, length, callback_libusbtransfer, &contexts[i], 0);
-    contexts[i].done = false;
-    contexts[i].bytesXfered = 0;
+    libusb_transfer *tr = contexts[i]->transfer;
+    libusb_fill_bulk_transfer(tr, dev_handle, streamRdEp, (unsigned char*)buffer, length, callback_libusbtransfer, contexts[i].get(), 0);
+    contexts[i]->done = false;
+    contexts[i]->bytesXfered = 0;
+    contexts[i]->completions = &readCompletions;
+    contexts[i]->handle = i;
     int status = libusb_submit_transfer(tr);
     if(status != 0)
     {
         lime::error("ERROR BEGIN DATA READING %s", libusb_error_name(status));
-        contexts[i].used = false;
+        contexts[i]->used = false;
         return -1;
     }
 #endif
@@ -473,24 +556,14 @@ int ConnectionFT601::BeginDataReading(char *buffer, uint32_t length, int ep)
 */
 bool ConnectionFT601::WaitForReading(int contextHandle, unsigned int timeout_ms)
 {
-    if(contextHandle >= 0 && contexts[contextHandle].used == true)
+    if(contextHandle >= 0 && contexts[contextHandle]->used == true)
     {
 #ifndef __unix__
-        DWORD dwRet = WaitForSingleObject(contexts[contextHandle].inOvLap.hEvent, timeout_ms);
+        DWORD dwRet = WaitForSingleObject(contexts[contextHandle]->inOvLap.hEvent, timeout_ms);
             if (dwRet == WAIT_OBJECT_0)
                 return 1;
 #else
-        auto t1 = chrono::high_resolution_clock::now();
-        auto t2 = t1;
-
-        std::unique_lock<std::mutex> lck(contexts[contextHandle].transferLock);
-        while(contexts[contextHandle].done.load() == false && std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeout_ms)
-        {
-            //blocking not to waste CPU
-            contexts[contextHandle].cv.wait_for(lck, chrono::milliseconds(timeout_ms));
-            t2 = chrono::high_resolution_clock::now();
-        }
-        return contexts[contextHandle].done.load() == true;
+        return WaitForCompletion(*contexts[contextHandle], readCompletions, timeout_ms);
 #endif
     }
     return true;  //there is nothing to wait for (signal wait finished)
@@ -505,23 +578,23 @@ bool ConnectionFT601::WaitForReading(int contextHandle, unsigned int timeout_ms)
 */
 int ConnectionFT601::FinishDataReading(char *buffer, uint32_t length, int contextHandle)
 {
-    if(contextHandle >= 0 && contexts[contextHandle].used == true)
+    if(contextHandle >= 0 && contexts[contextHandle]->used == true)
     {
 #ifndef __unix__
 	ULONG ulActualBytesTransferred;
         FT_STATUS ftStatus = FT_OK;
 
-        ftStatus = FT_GetOverlappedResult(mFTHandle, &contexts[contextHandle].inOvLap, &ulActualBytesTransferred, FALSE);
+        ftStatus = FT_GetOverlappedResult(mFTHandle, &contexts[contextHandle]->inOvLap, &ulActualBytesTransferred, FALSE);
         if (ftStatus != FT_OK)
             length = 0;
         else
             length = ulActualBytesTransferred;
-        FT_ReleaseOverlapped(mFTHandle, &contexts[contextHandle].inOvLap);
-        contexts[contextHandle].used = false;
+        FT_ReleaseOverlapped(mFTHandle, &contexts[contextHandle]->inOvLap);
+        contexts[contextHandle]->used = false;
         return length;
 #else
-        length = contexts[contextHandle].bytesXfered;
-        contexts[contextHandle].used = false;
+        length = contexts[contextHandle]->bytesXfered;
+        contexts[contextHandle]->used = false;
         return length;
 #endif
     }
@@ -535,31 +608,31 @@ void ConnectionFT601::AbortReading(int ep)
 {
 #ifndef __unix__
     FT_AbortPipe(mFTHandle, streamRdEp);
-    for (int i = 0; i < USB_MAX_CONTEXTS; ++i)
+    for (int i = 0; i < (int)contexts.size(); ++i)
     {
-        if (contexts[i].used == true)
+        if (contexts[i]->used == true)
         {
-            FT_ReleaseOverlapped(mFTHandle, &contexts[i].inOvLap);
-            contexts[i].used = false;
+            FT_ReleaseOverlapped(mFTHandle, &contexts[i]->inOvLap);
+            contexts[i]->used = false;
         }
     }
     FT_FlushPipe(mFTHandle, streamRdEp);
     FT_SetStreamPipe(mFTHandle, FALSE, FALSE, streamRdEp, sizeof(FPGA_DataPacket));
 #else
 
-    for(int i = 0; i<USB_MAX_CONTEXTS; ++i)
+    for(int i = 0; i < (int)contexts.size(); ++i)
     {
-        if(contexts[i].used)
+        if(contexts[i]->used)
 	{
             if (WaitForReading(i, 100))
                 FinishDataReading(nullptr, 0, i);
             else
-            	libusb_cancel_transfer(contexts[i].transfer);
+            	libusb_cancel_transfer(contexts[i]->transfer);
 	}
     }
-    for(int i=0; i<USB_MAX_CONTEXTS; ++i)
+    for(int i=0; i < (int)contexts.size(); ++i)
     {
-        if(contexts[i].used)
+        if(contexts[i]->used)
         {
             WaitForReading(i, 100);
             FinishDataReading(nullptr, 0, i);
@@ -576,42 +649,34 @@ void ConnectionFT601::AbortReading(int ep)
 */
 int ConnectionFT601::BeginDataSending(const char *buffer, uint32_t length, int ep)
 {
-    int i = 0;
-    //find not used context
-    bool contextFound = false;
-    for(i = 0; i<USB_MAX_CONTEXTS; i++)
-    {
-        if(!contextsToSend[i].used)
-        {
-            contextFound = true;
-            break;
-        }
-    }
-    if(!contextFound)
+    const int i = GetFreeContext(contextsToSend, USB_MAX_CONTEXTS);
+    if(i < 0)
         return -1;
-    contextsToSend[i].used = true;
+    contextsToSend[i]->used = true;
 
 #ifndef __unix__
 	FT_STATUS ftStatus = FT_OK;
 	ULONG ulActualBytesSend;
-    FT_InitializeOverlapped(mFTHandle, &contextsToSend[i].inOvLap);
-	ftStatus = FT_WritePipe(mFTHandle, streamWrEp, (unsigned char*)buffer, length, &ulActualBytesSend, &contextsToSend[i].inOvLap);
+    FT_InitializeOverlapped(mFTHandle, &contextsToSend[i]->inOvLap);
+	ftStatus = FT_WritePipe(mFTHandle, streamWrEp, (unsigned char*)buffer, length, &ulActualBytesSend, &contextsToSend[i]->inOvLap);
 	if (ftStatus != FT_IO_PENDING)
     {
         lime::error("ERROR BEGIN DATA SENDING %d", ftStatus);
-        contexts[i].used = false;
+        contextsToSend[i]->used = false;
         return -1;
     }
 #else
-    libusb_transfer *tr = contextsToSend[i].transfer;
-    contextsToSend[i].done = false;
-    contextsToSend[i].bytesXfered = 0;
-    libusb_fill_bulk_transfer(tr, dev_handle, streamWrEp, (unsigned char*)buffer, length, callback_libusbtransfer, &contextsToSend[i], 0);
+    libusb_transfer *tr = contextsToSend[i]->transfer;
+    contextsToSend[i]->done = false;
+    contextsToSend[i]->bytesXfered = 0;
+    contextsToSend[i]->completions = &sendCompletions;
+    contextsToSend[i]->handle = i;
+    libusb_fill_bulk_transfer(tr, dev_handle, streamWrEp, (unsigned char*)buffer, length, callback_libusbtransfer, contextsToSend[i].get(), 0);
     int status = libusb_submit_transfer(tr);
     if(status != 0)
     {
         lime::error("ERROR BEGIN DATA SENDING %s", libusb_error_name(status));
-        contextsToSend[i].used = false;
+        contextsToSend[i]->used = false;
         return -1;
     }
 #endif
@@ -626,23 +691,14 @@ int ConnectionFT601::BeginDataSending(const char *buffer, uint32_t length, int e
 */
 bool ConnectionFT601::WaitForSending(int contextHandle, unsigned int timeout_ms)
 {
-    if(contextHandle >= 0 && contextsToSend[contextHandle].used == true)
+    if(contextHandle >= 0 && contextsToSend[contextHandle]->used == true)
     {
 #ifndef __unix__
-        DWORD dwRet = WaitForSingleObject(contextsToSend[contextHandle].inOvLap.hEvent, timeout_ms);
+        DWORD dwRet = WaitForSingleObject(contextsToSend[contextHandle]->inOvLap.hEvent, timeout_ms);
             if (dwRet == WAIT_OBJECT_0)
                 return 1;
 #else
-        auto t1 = chrono::high_resolution_clock::now();
-        auto t2 = t1;
-        std::unique_lock<std::mutex> lck(contextsToSend[contextHandle].transferLock);
-        while(contextsToSend[contextHandle].done.load() == false && std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeout_ms)
-        {
-            //blocking not to waste CPU
-            contextsToSend[contextHandle].cv.wait_for(lck, chrono::milliseconds(timeout_ms));
-            t2 = chrono::high_resolution_clock::now();
-        }
-        return contextsToSend[contextHandle].done == true;
+        return WaitForCompletion(*contextsToSend[contextHandle], sendCompletions, timeout_ms);
 #endif
     }
     return true; //there is nothing to wait for (signal wait finished)
@@ -657,22 +713,22 @@ bool ConnectionFT601::WaitForSending(int contextHandle, unsigned int timeout_ms)
 */
 int ConnectionFT601::FinishDataSending(const char *buffer, uint32_t length, int contextHandle)
 {
-    if(contextHandle >= 0 && contextsToSend[contextHandle].used == true)
+    if(contextHandle >= 0 && contextsToSend[contextHandle]->used == true)
     {
 #ifndef __unix__
         ULONG ulActualBytesTransferred ;
         FT_STATUS ftStatus = FT_OK;
-        ftStatus = FT_GetOverlappedResult(mFTHandle, &contextsToSend[contextHandle].inOvLap, &ulActualBytesTransferred, FALSE);
+        ftStatus = FT_GetOverlappedResult(mFTHandle, &contextsToSend[contextHandle]->inOvLap, &ulActualBytesTransferred, FALSE);
         if (ftStatus != FT_OK)
             length = 0;
         else
         length = ulActualBytesTransferred;
-        FT_ReleaseOverlapped(mFTHandle, &contextsToSend[contextHandle].inOvLap);
-	    contextsToSend[contextHandle].used = false;
+        FT_ReleaseOverlapped(mFTHandle, &contextsToSend[contextHandle]->inOvLap);
+	    contextsToSend[contextHandle]->used = false;
 	    return length;
 #else
-        length = contextsToSend[contextHandle].bytesXfered;
-        contextsToSend[contextHandle].used = false;
+        length = contextsToSend[contextHandle]->bytesXfered;
+        contextsToSend[contextHandle]->used = false;
         return length;
 #endif
     }
@@ -687,29 +743,29 @@ void ConnectionFT601::AbortSending(int ep)
 {
 #ifndef __unix__
     FT_AbortPipe(mFTHandle, streamWrEp);
-    for (int i = 0; i < USB_MAX_CONTEXTS; ++i)
+    for (int i = 0; i < (int)contextsToSend.size(); ++i)
     {
-        if (contextsToSend[i].used == true)
+        if (contextsToSend[i]->used == true)
         {
-            FT_ReleaseOverlapped(mFTHandle, &contextsToSend[i].inOvLap);
-            contextsToSend[i].used = false;
+            FT_ReleaseOverlapped(mFTHandle, &contextsToSend[i]->inOvLap);
+            contextsToSend[i]->used = false;
         }
     }
     FT_SetStreamPipe(mFTHandle, FALSE, FALSE, streamWrEp, sizeof(FPGA_DataPacket));
 #else
-    for(int i = 0; i<USB_MAX_CONTEXTS; ++i)
+    for(int i = 0; i < (int)contextsToSend.size(); ++i)
     {
-        if(contextsToSend[i].used)
+        if(contextsToSend[i]->used)
         {
             if (WaitForSending(i, 100))
                 FinishDataSending(nullptr, 0, i);
             else
-                libusb_cancel_transfer(contextsToSend[i].transfer);
+                libusb_cancel_transfer(contextsToSend[i]->transfer);
         }
     }
-    for (int i = 0; i<USB_MAX_CONTEXTS; ++i)
+    for (int i = 0; i < (int)contextsToSend.size(); ++i)
     {
-        if(contextsToSend[i].used)
+        if(contextsToSend[i]->used)
         {
             WaitForSending(i, 100);
             FinishDataSending(nullptr, 0, i);
@@ -8,7 +8,9 @@
 #include <ConnectionRegistry.h>
 #include <IConnection.h>
 #include "LMS64CProtocol.h"
+#include "fifo.h"
 #include <vector>
+#include <set>
 #include <string>
 #include <atomic>
 #include <memory>
@@ -42,6 +44,8 @@ public:
             transfer = libusb_alloc_transfer(0);
             bytesXfered = 0;
             done = 0;
+            completions = nullptr;
+            handle = -1;
 #endif
         }
         ~USBTransferContext()
@@ -58,8 +62,8 @@ public:
         libusb_transfer* transfer;
         long bytesXfered;
         std::atomic<bool> done;
-        std::mutex transferLock;
-        std::condition_variable cv;
+        MPSCQueue<int>* completions; //receives handle of context when transfer completes
+        int handle;
 #endif
     };
 
@@ -87,6 +91,7 @@ public:
 
 protected:
     int GetBuffersCount() const override;
+    int CheckBuffersCount(int count) const override;
     int CheckStreamSize(int size) const override;
     int BeginDataReading(char* buffer, uint32_t length, int ep) override;
     bool WaitForReading(int contextHandle, unsigned int timeout_ms) override;
@@ -99,13 +104,17 @@ protected:
     void AbortSending(int ep) override;
     
     int ResetStreamBuffers() override;
+    char* AllocateStreamBuffer(size_t length) override;
+    void FreeStreamBuffer(char* buffer, size_t length) override;
 
     eConnectionType GetType(void) {return USB_PORT;}
     
-    static const int USB_MAX_CONTEXTS = 16; //maximum number of contexts for asynchronous transfers
+    static const int USB_MAX_CONTEXTS = 256; //maximum number of contexts for asynchronous transfers
+    static const int USB_DEFAULT_CONTEXTS = 16; //default number of transfers in flight
 
-    USBTransferContext contexts[USB_MAX_CONTEXTS];
-    USBTransferContext contextsToSend[USB_MAX_CONTEXTS];
+    //contexts are added when all of them are in use, up to USB_MAX_CONTEXTS
+    std::vector<std::unique_ptr<USBTransferContext>> contexts;
+    std::vector<std::unique_ptr<USBTransferContext>> contextsToSend;
 
     bool isConnected;
 
@@ -122,6 +131,9 @@ protected:
     uint32_t mUsbCounter;
     libusb_device_handle *dev_handle; //a device handle
     libusb_context *ctx; //a libusb session
+    std::set<char*> devMemBuffers; //stream buffers allocated in usbfs DMA memory
+    MPSCQueue<int> readCompletions; //handles of completed reading contexts
+    MPSCQueue<int> sendCompletions; //handles of completed sending contexts
 #endif
     std::mutex mExtraUsbMutex;
     uint64_t mSerial;
@@ -6,6 +6,8 @@
 
 #include "ConnectionFX3.h"
 #include <cstring>
+#include <algorithm>
+#include <stdlib.h>
 #include "Si5351C.h"
 #include "FPGA_common.h"
 #include "LMS7002M.h"
@@ -52,6 +54,9 @@ const std::set<uint8_t> ConnectionFX3::commandsToBulkCtrlHw2 =
 /**	@brief Initializes port type and object necessary to communicate to usb device.
 */
 ConnectionFX3::ConnectionFX3(void *arg, const std::string &vidpid, const std::string &serial, const unsigned index)
+#ifdef __unix__
+    : readCompletions(USB_MAX_CONTEXTS), sendCompletions(USB_MAX_CONTEXTS)
+#endif
 {
     bulkCtrlAvailable = false;
     bulkCtrlInProgress = false;
@@ -409,7 +414,6 @@ int ConnectionFX3::Read(unsigned char *buffer, const int length, int timeout_ms)
 void callback_libusbtransfer(libusb_transfer *trans)
 {
 	USBTransferContext *context = reinterpret_cast<USBTransferContext*>(trans->user_data);
-	std::unique_lock<std::mutex> lck(context->transferLock);
 	switch(trans->status)
 	{
     case LIBUSB_TRANSFER_CANCELLED:
@@ -439,11 +443,47 @@ void callback_libusbtransfer(libusb_transfer *trans)
         lime::error("USB transfer no device");
         break;
 	}
-	lck.unlock();
-	context->cv.notify_one();
+    if (context->done.load())
+        context->completions->push(context->handle);
+}
+
+/** @brief Waits for transfer of context to complete.
+    Wakes up when any transfer completes and takes all completed handles from
+    the queue at once, so that waiting for them afterwards does not block.
+*/
+template<class Context>
+static bool WaitForCompletion(Context& context, MPSCQueue<int>& completions, unsigned int timeout_ms)
+{
+    const auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout_ms);
+    int handle;
+    while (context.done.load() == false)
+    {
+        const auto now = chrono::steady_clock::now();
+        if (now >= deadline)
+            return false;
+        const auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - now).count();
+        if (completions.pop(handle, std::max<long>(1, remaining)))
+            while (completions.pop(handle, 0));
+    }
+    return true;
 }
 #endif
 
+/** @brief Returns index of unused transfer context, adds new context to the pool if all are in use
+    @return context index, -1 if pool already has maxCount contexts
+*/
+template<class Context>
+static int GetFreeContext(std::vector<std::unique_ptr<Context>>& pool, const int maxCount)
+{
+    for (size_t i = 0; i < pool.size(); ++i)
+        if (!pool[i]->used)
+            return i;
+    if ((int)pool.size() >= maxCount)
+        return -1;
+    pool.emplace_back(new Context());
+    return pool.size()-1;
+}
+
 /**
 	@brief Starts asynchronous data reading from board
 	@param *buffer buffer where to store received data
@@ -454,40 +494,32 @@ void callback_libusbtransfer(libusb_transfer *trans)
 int ConnectionFX3::BeginDataReading(char *buffer, uint32_t length, int ep)
 {
     const unsigned char streamBulkInAddr = 0x81;
-    int i = 0;
-	bool contextFound = false;
-	//find not used context
-    for(i = 0; i<USB_MAX_CONTEXTS; i++)
-    {
-        if(!contexts[i].used)
-        {
-            contextFound = true;
-            break;
-        }
-    }
-    if(!contextFound)
+    const int i = GetFreeContext(contexts, USB_MAX_CONTEXTS);
+    if(i < 0)
     {
         lime::error("No contexts left for reading data");
         return -1;
     }
-    contexts[i].used = true;
+    contexts[i]->used = true;
     #ifndef __unix__
     if (InEndPt[streamBulkInAddr & 0xF])
     {
-        contexts[i].EndPt = InEndPt[streamBulkInAddr & 0xF];
-        contexts[i].context = contexts[i].EndPt->BeginDataXfer((unsigned char*)buffer, length, contexts[i].inOvLap);
+        contexts[i]->EndPt = InEndPt[streamBulkInAddr & 0xF];
+        contexts[i]->context = contexts[i]->EndPt->BeginDataXfer((unsigned char*)buffer, length, contexts[i]->inOvLap);
     }
 	return i;
     #else
-    libusb_transfer *tr = contexts[i].transfer;
-    libusb_fill_bulk_transfer(tr, dev_handle, streamBulkInAddr, (unsigned char*)buffer, length, callback_libusbtransfer, &contexts[i], 0);
-    contexts[i].done = false;
-    contexts[i].bytesXfered = 0;
+    libusb_transfer *tr = contexts[i]->transfer;
+    libusb_fill_bulk_transfer(tr, dev_handle, streamBulkInAddr, (unsigned char*)buffer, length, callback_libusbtransfer, contexts[i].get(), 0);
+    contexts[i]->done = false;
+    contexts[i]->bytesXfered = 0;
+    contexts[i]->completions = &readCompletions;
+    contexts[i]->handle = i;
     int status = libusb_submit_transfer(tr);
     if(status != 0)
     {
         lime::error("BEGIN DATA READING %s", libusb_error_name(status));
-        contexts[i].used = false;
+        contexts[i]->used = false;
         return -1;
     }
     #endif
@@ -502,24 +534,14 @@ int ConnectionFX3::BeginDataReading(char *buffer, uint32_t length, int ep)
 */
 bool ConnectionFX3::WaitForReading(int contextHandle, unsigned int timeout_ms)
 {
-    if(contextHandle >= 0 && contexts[contextHandle].used == true)
+    if(contextHandle >= 0 && contexts[contextHandle]->used == true)
     {
     #ifndef __unix__
     int status = 0;
-    status = contexts[contextHandle].EndPt->WaitForXfer(contexts[contextHandle].inOvLap, timeout_ms);
+    status = contexts[contextHandle]->EndPt->WaitForXfer(contexts[contextHandle]->inOvLap, timeout_ms);
 	return status;
     #else
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = t1;
-
-    std::unique_lock<std::mutex> lck(contexts[contextHandle].transferLock);
-    while(contexts[contextHandle].done.load() == false && std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeout_ms)
-    {
-        //blocking not to waste CPU
-        contexts[contextHandle].cv.wait_for(lck, chrono::milliseconds(timeout_ms));
-        t2 = chrono::high_resolution_clock::now();
-    }
-    return contexts[contextHandle].done.load() == true;
+    return WaitForCompletion(*contexts[contextHandle], readCompletions, timeout_ms);
     #endif
     }
     return true;  //there is nothing to wait for (signal wait finished)
@@ -534,19 +556,19 @@ bool ConnectionFX3::WaitForReading(int contextHandle, unsigned int timeout_ms)
 */
 int ConnectionFX3::FinishDataReading(char *buffer, uint32_t length, int contextHandle)
 {
-    if(contextHandle >= 0 && contexts[contextHandle].used == true)
+    if(contextHandle >= 0 && contexts[contextHandle]->used == true)
     {
     #ifndef __unix__
     int status = 0;
     long len = length;
-    status = contexts[contextHandle].EndPt->FinishDataXfer((unsigned char*)buffer, len, contexts[contextHandle].inOvLap, contexts[contextHandle].context);
-    contexts[contextHandle].used = false;
-    contexts[contextHandle].reset();
+    status = contexts[contextHandle]->EndPt->FinishDataXfer((unsigned char*)buffer, len, contexts[contextHandle]->inOvLap, contexts[contextHandle]->context);
+    contexts[contextHandle]->used = false;
+    contexts[contextHandle]->reset();
     return len;
     #else
-	length = contexts[contextHandle].bytesXfered;
-	contexts[contextHandle].used = false;
-	contexts[contextHandle].reset();
+	length = contexts[contextHandle]->bytesXfered;
+	contexts[contextHandle]->used = false;
+	contexts[contextHandle]->reset();
 	return length;
     #endif
     }
@@ -564,15 +586,15 @@ void ConnectionFX3::AbortReading(int ep)
         if (InEndPt[i] && InEndPt[i]->Address == 0x81)
 	        InEndPt[i]->Abort();
 #else
-    for(int i=0; i<USB_MAX_CONTEXTS; ++i)
+    for(int i=0; i < (int)contexts.size(); ++i)
     {
-        if(contexts[i].used && contexts[i].transfer->endpoint == 0x81)
-            libusb_cancel_transfer( contexts[i].transfer );
+        if(contexts[i]->used && contexts[i]->transfer->endpoint == 0x81)
+            libusb_cancel_transfer( contexts[i]->transfer );
     }
 #endif
-    for(int i=0; i<USB_MAX_CONTEXTS; ++i)
+    for(int i=0; i < (int)contexts.size(); ++i)
     {
-        if(contexts[i].used)
+        if(contexts[i]->used)
         {
             WaitForReading(i, 250);
             FinishDataReading(nullptr, 0, i);
@@ -590,37 +612,29 @@ void ConnectionFX3::AbortReading(int ep)
 int ConnectionFX3::BeginDataSending(const char *buffer, uint32_t length, int ep)
 {
     const unsigned char streamBulkOutAddr = 0x01;
-    int i = 0;
-	//find not used context
-	bool contextFound = false;
-    for(i = 0; i<USB_MAX_CONTEXTS; i++)
-    {
-        if(!contextsToSend[i].used)
-        {
-            contextFound = true;
-            break;
-        }
-    }
-    if(!contextFound)
+    const int i = GetFreeContext(contextsToSend, USB_MAX_CONTEXTS);
+    if(i < 0)
         return -1;
-    contextsToSend[i].used = true;
+    contextsToSend[i]->used = true;
     #ifndef __unix__
     if (OutEndPt[streamBulkOutAddr])
     {
-        contextsToSend[i].EndPt = OutEndPt[streamBulkOutAddr];
-        contextsToSend[i].context = contextsToSend[i].EndPt->BeginDataXfer((unsigned char*)buffer, length, contextsToSend[i].inOvLap);
+        contextsToSend[i]->EndPt = OutEndPt[streamBulkOutAddr];
+        contextsToSend[i]->context = contextsToSend[i]->EndPt->BeginDataXfer((unsigned char*)buffer, length, contextsToSend[i]->inOvLap);
     }
 	return i;
     #else
-    libusb_transfer *tr = contextsToSend[i].transfer;
-    contextsToSend[i].done = false;
-    contextsToSend[i].bytesXfered = 0;
-    libusb_fill_bulk_transfer(tr, dev_handle, streamBulkOutAddr, (unsigned char*)buffer, length, callback_libusbtransfer, &contextsToSend[i], 0);
+    libusb_transfer *tr = contextsToSend[i]->transfer;
+    contextsToSend[i]->done = false;
+    contextsToSend[i]->bytesXfered = 0;
+    contextsToSend[i]->completions = &sendCompletions;
+    contextsToSend[i]->handle = i;
+    libusb_fill_bulk_transfer(tr, dev_handle, streamBulkOutAddr, (unsigned char*)buffer, length, callback_libusbtransfer, contextsToSend[i].get(), 0);
     int status = libusb_submit_transfer(tr);
     if(status != 0)
     {
         lime::error("BEGIN DATA SENDING %s", libusb_error_name(status));
-        contextsToSend[i].used = false;
+        contextsToSend[i]->used = false;
         return -1;
     }
     #endif
@@ -635,24 +649,14 @@ int ConnectionFX3::BeginDataSending(const char *buffer, uint32_t length, int ep)
 */
 bool ConnectionFX3::WaitForSending(int contextHandle, unsigned int timeout_ms)
 {
-    if(contextHandle >= 0 && contextsToSend[contextHandle].used == true )
+    if(contextHandle >= 0 && contextsToSend[contextHandle]->used == true )
     {
 #   ifndef __unix__
 	int status = 0;
-	status = contextsToSend[contextHandle].EndPt->WaitForXfer(contextsToSend[contextHandle].inOvLap, timeout_ms);
+	status = contextsToSend[contextHandle]->EndPt->WaitForXfer(contextsToSend[contextHandle]->inOvLap, timeout_ms);
 	return status;
 #   else
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = t1;
-
-    std::unique_lock<std::mutex> lck(contextsToSend[contextHandle].transferLock);
-    while(contextsToSend[contextHandle].done.load() == false && std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeout_ms)
-    {
-        //blocking not to waste CPU
-        contextsToSend[contextHandle].cv.wait_for(lck, chrono::milliseconds(timeout_ms));
-        t2 = chrono::high_resolution_clock::now();
-    }
-	return contextsToSend[contextHandle].done == true;
+    return WaitForCompletion(*contextsToSend[contextHandle], sendCompletions, timeout_ms);
 #   endif
     }
     return true;  //there is nothing to wait for (signal wait finished)
@@ -667,18 +671,18 @@ bool ConnectionFX3::WaitForSending(int contextHandle, unsigned int timeout_ms)
 */
 int ConnectionFX3::FinishDataSending(const char *buffer, uint32_t length, int contextHandle)
 {
-    if(contextHandle >= 0 && contextsToSend[contextHandle].used == true)
+    if(contextHandle >= 0 && contextsToSend[contextHandle]->used == true)
     {
 #ifndef __unix__
         long len = length;
-        contextsToSend[contextHandle].EndPt->FinishDataXfer((unsigned char*)buffer, len, contextsToSend[contextHandle].inOvLap, contextsToSend[contextHandle].context);
-        contextsToSend[contextHandle].used = false;
-        contextsToSend[contextHandle].reset();
+        contextsToSend[contextHandle]->EndPt->FinishDataXfer((unsigned char*)buffer, len, contextsToSend[contextHandle]->inOvLap, contextsToSend[contextHandle]->context);
+        contextsToSend[contextHandle]->used = false;
+        contextsToSend[contextHandle]->reset();
         return len;
 #else
-	length = contextsToSend[contextHandle].bytesXfered;
-	contextsToSend[contextHandle].used = false;
-        contextsToSend[contextHandle].reset();
+	length = contextsToSend[contextHandle]->bytesXfered;
+	contextsToSend[contextHandle]->used = false;
+        contextsToSend[contextHandle]->reset();
 	return length;
 #endif
     }
@@ -696,15 +700,15 @@ void ConnectionFX3::AbortSending(int ep)
         if (OutEndPt[i] && OutEndPt[i]->Address == 0x01)
             OutEndPt[i]->Abort();
 #else
-    for (int i = 0; i<USB_MAX_CONTEXTS; ++i)
+    for (int i = 0; i < (int)contextsToSend.size(); ++i)
     {
-        if(contextsToSend[i].used && contextsToSend[i].transfer->endpoint == 0x01)
-            libusb_cancel_transfer(contextsToSend[i].transfer);
+        if(contextsToSend[i]->used && contextsToSend[i]->transfer->endpoint == 0x01)
+            libusb_cancel_transfer(contextsToSend[i]->transfer);
     }
 #endif
-    for (int i = 0; i<USB_MAX_CONTEXTS; ++i)
+    for (int i = 0; i < (int)contextsToSend.size(); ++i)
     {
-        if(contextsToSend[i].used)
+        if(contextsToSend[i]->used)
         {
             WaitForSending(i, 250);
             FinishDataSending(nullptr, 0, i);
@@ -712,9 +716,57 @@ void ConnectionFX3::AbortSending(int ep)
     }
 }
 
+/** @brief Allocates stream buffer in usbfs DMA memory, so that kernel transfers
+    samples directly to/from it without copying. Falls back to page aligned memory
+    if DMA memory is not available.
+*/
+char* ConnectionFX3::AllocateStreamBuffer(size_t length)
+{
+#ifdef __unix__
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+    unsigned char* devMem = libusb_dev_mem_alloc(dev_handle, length);
+    if (devMem)
+    {
+        std::lock_guard<std::mutex> lock(mExtraUsbMutex);
+        devMemBuffers.insert((char*)devMem);
+        return (char*)devMem;
+    }
+    lime::debug("USB DMA memory is not available, using regular stream buffers");
+#endif
+    void* aligned = nullptr;
+    if (posix_memalign(&aligned, 4096, length) != 0)
+        return nullptr;
+    return (char*)aligned;
+#else
+    return nullptr;
+#endif
+}
+
+void ConnectionFX3::FreeStreamBuffer(char* buffer, size_t length)
+{
+#ifdef __unix__
+    {
+        std::lock_guard<std::mutex> lock(mExtraUsbMutex);
+        if (devMemBuffers.erase(buffer))
+        {
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+            libusb_dev_mem_free(dev_handle, (unsigned char*)buffer, length);
+#endif
+            return;
+        }
+    }
+    free(buffer);
+#endif
+}
+
 int ConnectionFX3::GetBuffersCount() const
 {
-    return USB_MAX_CONTEXTS;
+    return USB_DEFAULT_CONTEXTS;
+}
+
+int ConnectionFX3::CheckBuffersCount(int count) const
+{
+    return std::max(1, std::min(count, int(USB_MAX_CONTEXTS)));
 }
 
 int ConnectionFX3::CheckStreamSize(int size)const
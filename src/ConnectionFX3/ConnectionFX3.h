@@ -8,6 +8,7 @@
 #include <ConnectionRegistry.h>
 
 #include "LMS64CProtocol.h"
+#include "fifo.h"
 #include <vector>
 #include <set>
 #include <string>
@@ -46,6 +47,8 @@ public:
         transfer = libusb_alloc_transfer(0);
         bytesXfered = 0;
         done = 0;
+        completions = nullptr;
+        handle = -1;
 #endif
     }
     ~USBTransferContext()
@@ -77,8 +80,8 @@ public:
     libusb_transfer* transfer;
     long bytesXfered;
     std::atomic<bool> done;
-    std::mutex transferLock;
-    std::condition_variable cv;
+    MPSCQueue<int>* completions; //receives handle of context when transfer completes
+    int handle;
 #endif
 };
 
@@ -100,6 +103,7 @@ public:
     int ProgramWrite(const char *buffer, const size_t length, const int programmingMode, const int device, ProgrammingCallback callback) override;
 protected:
     int GetBuffersCount() const;
+    int CheckBuffersCount(int count) const;
     int CheckStreamSize(int size)const;
     int SendData(const char* buffer, int length, int epIndex = 0, int timeout = 100)override;
     int ReceiveData(char* buffer, int length, int epIndex = 0, int timeout = 100)override;
@@ -115,12 +119,16 @@ protected:
     void AbortSending(int ep) override;
 
     int ResetStreamBuffers() override;
+    char* AllocateStreamBuffer(size_t length) override;
+    void FreeStreamBuffer(char* buffer, size_t length) override;
     eConnectionType GetType(void) {return USB_PORT;}
     
-    static const int USB_MAX_CONTEXTS = 16; //maximum number of contexts for asynchronous transfers
+    static const int USB_MAX_CONTEXTS = 256; //maximum number of contexts for asynchronous transfers
+    static const int USB_DEFAULT_CONTEXTS = 16; //default number of transfers in flight
     
-    USBTransferContext contexts[USB_MAX_CONTEXTS];
-    USBTransferContext contextsToSend[USB_MAX_CONTEXTS];
+    //contexts are added when all of them are in use, up to USB_MAX_CONTEXTS
+    std::vector<std::unique_ptr<USBTransferContext>> contexts;
+    std::vector<std::unique_ptr<USBTransferContext>> contextsToSend;
 
     bool isConnected;
 
@@ -140,6 +148,9 @@ protected:
 #else
     libusb_device_handle* dev_handle; //a device handle
     libusb_context* ctx; //a libusb session
+    std::set<char*> devMemBuffers; //stream buffers allocated in usbfs DMA memory
+    MPSCQueue<int> readCompletions; //handles of completed reading contexts
+    MPSCQueue<int> sendCompletions; //handles of completed sending contexts
     int read_firmware_image(unsigned char *buf, int len);
     int fx3_usbboot_download(unsigned char *buf, int len);
     int ram_write(unsigned char *buf, unsigned int ramAddress, int len);
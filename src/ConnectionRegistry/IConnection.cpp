@@ -124,10 +124,36 @@ int IConnection::CheckStreamSize(int size)const
     return 0;
 }
 
+/** @brief Returns number of stream transfers connection can keep in flight,
+    closest to requested count
+*/
+int IConnection::CheckBuffersCount(int count)const
+{
+    return GetBuffersCount();
+}
+
 int IConnection::ResetStreamBuffers()
 {
     return 0;
 }
+
+/** @brief Allocates memory for stream transfers, which connection can transfer
+    without copying it, for use with BeginDataReading() and BeginDataSending()
+    @param length buffer size in bytes
+    @return buffer, nullptr if connection does not provide stream buffers
+*/
+char* IConnection::AllocateStreamBuffer(size_t length)
+{
+    return nullptr;
+}
+
+/** @brief Frees buffer allocated with AllocateStreamBuffer()
+    @param buffer buffer to free
+    @param length buffer size in bytes
+*/
+void IConnection::FreeStreamBuffer(char* buffer, size_t length)
+{
+}
 /***********************************************************************
  * Programming API
  **********************************************************************/
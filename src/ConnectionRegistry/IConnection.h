@@ -160,6 +160,7 @@ public:
     */
     virtual int ResetStreamBuffers();
     virtual int GetBuffersCount()const;
+    virtual int CheckBuffersCount(int count)const;
     virtual int CheckStreamSize(int size)const;
     virtual int ReceiveData(char* buffer, int length, int epIndex, int timeout = 100);
     virtual int SendData(const char* buffer, int length, int epIndex, int timeout = 100);
@@ -173,6 +174,9 @@ public:
     virtual bool WaitForReading(int contextHandle, unsigned int timeout_ms);
     virtual int FinishDataReading(char* buffer, uint32_t length, int contextHandle);
     virtual void AbortReading(int ep){};
+
+    virtual char* AllocateStreamBuffer(size_t length);
+    virtual void FreeStreamBuffer(char* buffer, size_t length);
     
     /***********************************************************************
      * Programming API
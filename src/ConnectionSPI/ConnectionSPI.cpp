@@ -553,6 +553,10 @@ int ConnectionSPI::FinishDataReading(char* buffer, uint32_t length, int contextH
 {
     if (fd_stream_clocks < 0) //lime spi
     {
+        //each packet is one read() on spidev. Unlike Xillybus this path has no
+        //io_uring engine: spidev does not support poll() and every read()/write()
+        //is a blocking spi_sync() transfer serialized by the bus lock, so queued
+        //ring operations would only run the same transfers one by one in kernel workers
         auto t1 = chrono::high_resolution_clock::now();
         do
         {
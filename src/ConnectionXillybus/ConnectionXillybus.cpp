@@ -9,6 +9,8 @@
 #include "Windows.h"
 #else
 #include <unistd.h>
+#include <poll.h>
+#include <cstdlib>
 #endif
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -23,11 +25,32 @@
 
 #include <thread>
 #include <chrono>
+#include <algorithm>
 
 using namespace std;
 
 using namespace lime;
 
+#ifdef __unix__
+/** @brief Waits for file descriptor to become ready instead of retrying nonblocking I/O
+    @param fd file descriptor
+    @param events poll() events to wait for
+    @param start start time of operation
+    @param timeout_ms timeout of operation in milliseconds
+*/
+static void WaitForDescriptor(int fd, short events, const chrono::high_resolution_clock::time_point& start, int timeout_ms)
+{
+    const int elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - start).count();
+    if (elapsed >= timeout_ms)
+        return;
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    poll(&pfd, 1, timeout_ms - elapsed);
+}
+#endif
+
 const std::vector<ConnectionXillybus::EPConfig> ConnectionXillybus::deviceConfigs = {
 #ifndef __unix__
     {
@@ -191,6 +214,7 @@ void ConnectionXillybus::Close()
     CloseControl();
     for (int i = 0; i < MAX_EP_CNT; i++)
     {
+        StopStreamReader(i);
         if( hWriteStream[i] >= 0)
             close(hWriteStream[i]);
         hWriteStream[i] = -1;
@@ -311,10 +335,14 @@ int ConnectionXillybus::Write(const unsigned char *buffer, const int length, int
         int bytesSent;
         if ((bytesSent  = write(hWrite, buffer+ totalBytesWritten, bytesToWrite))<0)
         {
-            if(errno == EINTR || errno == EAGAIN)
-                 continue;
-            ReportError(errno);
-            return totalBytesWritten;
+            if (errno == EAGAIN)
+                WaitForDescriptor(hWrite, POLLOUT, t1, timeout_ms);
+            else if (errno != EINTR)
+            {
+                ReportError(errno);
+                return totalBytesWritten;
+            }
+            continue;
         }
 #endif
         totalBytesWritten += bytesSent;
@@ -397,10 +425,14 @@ int ConnectionXillybus::Read(unsigned char *buffer, const int length, int timeou
         int bytesReceived;
         if ((bytesReceived = read(hRead, buffer+ totalBytesReaded, bytesToRead))<0)
         {
-           if(errno == EINTR || errno == EAGAIN)
-               continue;
-           ReportError(errno);
-           return totalBytesReaded;
+           if (errno == EAGAIN)
+               WaitForDescriptor(hRead, POLLIN, t1, timeout_ms);
+           else if (errno != EINTR)
+           {
+               ReportError(errno);
+               return totalBytesReaded;
+           }
+           continue;
         }
 #endif
         totalBytesReaded += bytesReceived;
@@ -428,7 +460,20 @@ int ConnectionXillybus::Read(unsigned char *buffer, const int length, int timeou
 
 int ConnectionXillybus::GetBuffersCount() const
 {
+#ifdef __unix__
+    return DEFAULT_READ_CONTEXTS;
+#else
+    return 1;
+#endif
+}
+
+int ConnectionXillybus::CheckBuffersCount(int count) const
+{
+#ifdef __unix__
+    return std::max(1, std::min(count, int(MAX_READ_CONTEXTS)));
+#else
     return 1;
+#endif
 }
 
 int ConnectionXillybus::CheckStreamSize(int size) const
@@ -455,16 +500,6 @@ int ConnectionXillybus::ReceiveData(char *buffer, int length, int epIndex, int t
             return -1;
         }
     }
-#else
-    if (hReadStream[epIndex] == -1)
-    {
-       if (( hReadStream[epIndex] = open(readStreamPort[epIndex].c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK))==-1)
-       {
-            ReportError(errno);
-            return 0;
-       }
-    }
-#endif
 
     int totalBytesReaded = 0;
     int bytesToRead = length;
@@ -472,7 +507,6 @@ int ConnectionXillybus::ReceiveData(char *buffer, int length, int epIndex, int t
 
     do
     {
- #ifndef __unix__
         DWORD bytesReceived = 0;
         OVERLAPPED	vOverlapped;
         memset(&vOverlapped, 0, sizeof(OVERLAPPED));
@@ -497,16 +531,6 @@ int ConnectionXillybus::ReceiveData(char *buffer, int length, int epIndex, int t
             bytesReceived = 0;
         }
         CloseHandle(vOverlapped.hEvent);
-#else
-        int bytesReceived;
-        if ((bytesReceived = read(hReadStream[epIndex], buffer+ totalBytesReaded, bytesToRead))<0)
-        {
-            if(errno == EINTR || errno == EAGAIN)
-                continue;
-            ReportError(errno);
-            return totalBytesReaded;
-        }
-#endif
         totalBytesReaded += bytesReceived;
         if (totalBytesReaded < length)
             bytesToRead -= bytesReceived;
@@ -516,8 +540,299 @@ int ConnectionXillybus::ReceiveData(char *buffer, int length, int epIndex, int t
     }while (std::chrono::duration_cast<std::chrono::milliseconds>(chrono::high_resolution_clock::now() - t1).count() < timeout_ms);
 
     return totalBytesReaded;
+#else
+    if (OpenReadStream(epIndex) != 0)
+        return 0;
+    return ReadStream(epIndex, buffer, length, timeout_ms);
+#endif
+}
+
+#ifdef __unix__
+//! Opens stream endpoint for reading, if it is not open yet
+int ConnectionXillybus::OpenReadStream(int epIndex)
+{
+    if (hReadStream[epIndex] == -1)
+    {
+       if (( hReadStream[epIndex] = open(readStreamPort[epIndex].c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK))==-1)
+            return ReportError(errno);
+    }
+    return 0;
+}
+
+/** @brief Reads stream endpoint until buffer is full, sleeping in poll() while there is no data
+    @param epIndex endpoint index
+    @param buffer array where to store received data
+    @param length number of bytes to read
+    @param timeout_ms read timeout in milliseconds
+    @param terminate flag to stop reading early, optional
+    @return number of bytes received
+*/
+int ConnectionXillybus::ReadStream(int epIndex, char* buffer, int length, int timeout_ms, const std::atomic<bool>* terminate)
+{
+    const int pollPeriod = 100; //period of checking terminate flag
+    int totalBytesReaded = 0;
+    auto t1 = chrono::high_resolution_clock::now();
+
+    while (totalBytesReaded < length)
+    {
+        const int bytesReceived = read(hReadStream[epIndex], buffer + totalBytesReaded, length - totalBytesReaded);
+        if (bytesReceived > 0)
+        {
+            totalBytesReaded += bytesReceived;
+            continue;
+        }
+        if (bytesReceived < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            ReportError(errno);
+            break;
+        }
+        if (terminate && terminate->load())
+            break;
+        const int elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - t1).count();
+        if (elapsed >= timeout_ms)
+            break;
+        WaitForDescriptor(hReadStream[epIndex], POLLIN, t1, terminate ? std::min(timeout_ms, elapsed + pollPeriod) : timeout_ms);
+    }
+    return totalBytesReaded;
+}
+
+/** @brief Reader thread of stream endpoint.
+    Fills queued buffers in submission order, so that data is read from the
+    device while previously filled buffers are being processed.
+*/
+void ConnectionXillybus::ReadStreamLoop(int epIndex)
+{
+    StreamReader& reader = readers[epIndex];
+    while (true)
+    {
+        int index;
+        {
+            std::unique_lock<std::mutex> lck(reader.lock);
+            reader.hasRequests.wait(lck, [&reader]{
+                return reader.terminate.load() || !reader.requests.empty();});
+            if (reader.terminate.load())
+                return;
+            index = reader.requests.front();
+        }
+        ReadContext& context = reader.contexts[index];
+        const int bytesRead = ReadStream(epIndex, context.buffer, context.length, 3000, &reader.terminate);
+        {
+            std::lock_guard<std::mutex> lck(reader.lock);
+            reader.requests.pop_front();
+            context.bytesRead = bytesRead;
+            context.done = true;
+        }
+        reader.hasResults.notify_all();
+    }
+}
+
+//! Stops reader thread of stream endpoint and drops queued reads
+void ConnectionXillybus::StopStreamReader(int epIndex)
+{
+    StreamReader& reader = readers[epIndex];
+    if (reader.thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lck(reader.lock);
+            reader.terminate.store(true);
+        }
+        reader.hasRequests.notify_one();
+        reader.thread.join();
+    }
+    std::lock_guard<std::mutex> lck(reader.lock);
+#ifdef XILLYBUS_IO_URING
+    StopRing(epIndex);
+#endif
+    reader.requests.clear();
+    for (auto& context : reader.contexts)
+    {
+        context.used = false;
+        context.done = false;
+    }
+}
+
+#ifdef XILLYBUS_IO_URING
+/** @brief Sets up io_uring of stream endpoint and registers stream buffers with it
+    @return false if io_uring is not available and reader thread has to be used
+*/
+bool ConnectionXillybus::StartRing(int epIndex)
+{
+    StreamReader& reader = readers[epIndex];
+    if (reader.ring.Init(2*MAX_READ_CONTEXTS) != 0)
+    {
+        reader.ringFailed = true;
+        lime::warning("Xillybus: io_uring is not available, stream is read by thread");
+        return false;
+    }
+    reader.ringInFlight = 0;
+    reader.terminate.store(false);
+    reader.fixedBuffers.clear();
+    std::lock_guard<std::mutex> lck(streamBuffersLock);
+    if (!streamBuffers.empty())
+    {
+        const int status = reader.ring.RegisterBuffers(streamBuffers.data(), streamBuffers.size());
+        if (status == 0)
+            reader.fixedBuffers = streamBuffers;
+        else
+            lime::debug("Xillybus: stream buffers not registered with io_uring (%s)", strerror(status));
+    }
+    return true;
+}
+
+/** @brief Submits all unfinished queued reads as one linked chain, if ring is idle.
+    Chain starts with poll, so that reads do not fail with EAGAIN while there is
+    no data. Linked reads are executed in order and the first short read cancels
+    the rest of the chain, so data is never placed out of order. Unfinished reads
+    are submitted again once the whole chain has completed.
+*/
+void ConnectionXillybus::SubmitRingReads(int epIndex)
+{
+    StreamReader& reader = readers[epIndex];
+    if (reader.ringInFlight != 0 || reader.requests.empty() || reader.terminate.load())
+        return;
+
+    io_uring_sqe* sqe = reader.ring.GetSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = hReadStream[epIndex];
+    sqe->poll_events = POLLIN;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = POLL_TAG;
+    int count = 1;
+    for (int index : reader.requests)
+    {
+        ReadContext& context = reader.contexts[index];
+        char* dest = context.buffer + context.bytesRead;
+        const uint32_t length = context.length - context.bytesRead;
+        sqe = reader.ring.GetSqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = hReadStream[epIndex];
+        sqe->addr = reinterpret_cast<uintptr_t>(dest);
+        sqe->len = length;
+        sqe->off = uint64_t(-1); //stream, use current file position
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = index;
+        for (size_t i = 0; i < reader.fixedBuffers.size(); ++i)
+        {
+            const char* base = static_cast<const char*>(reader.fixedBuffers[i].iov_base);
+            if (dest >= base && dest + length <= base + reader.fixedBuffers[i].iov_len)
+            {
+                sqe->opcode = IORING_OP_READ_FIXED;
+                sqe->buf_index = i;
+                break;
+            }
+        }
+        ++count;
+    }
+    sqe->flags = 0; //end of chain
+
+    if (reader.ring.Submit() < 0)
+    {
+        //return what has been read and continue with reader thread
+        for (int index : reader.requests)
+            reader.contexts[index].done = true;
+        reader.requests.clear();
+        reader.ring.Destroy();
+        reader.ringFailed = true;
+        reader.hasResults.notify_all();
+        return;
+    }
+    reader.ringInFlight = count;
+}
+
+/** @brief Processes all available completions of stream endpoint ring
+    and submits unfinished reads again when chain has completed
+*/
+void ConnectionXillybus::ReapRing(int epIndex)
+{
+    StreamReader& reader = readers[epIndex];
+    uint64_t tag;
+    int32_t result;
+    while (reader.ring.PopCompletion(tag, result))
+    {
+        if (tag == CANCEL_TAG)
+            continue;
+        --reader.ringInFlight;
+        if (tag == POLL_TAG)
+            continue;
+        ReadContext& context = reader.contexts[tag];
+        if (result > 0)
+            context.bytesRead += result;
+        else if (result == 0)
+            context.done = true; //end of stream
+        else if (result != -EAGAIN && result != -EINTR && result != -ECANCELED)
+        {
+            ReportError(-result);
+            context.done = true;
+        }
+        if (context.bytesRead >= int(context.length))
+            context.done = true;
+        if (context.done)
+            reader.requests.erase(std::find(reader.requests.begin(), reader.requests.end(), int(tag)));
+    }
+    SubmitRingReads(epIndex);
+}
+
+//! Cancels reads queued in ring of stream endpoint and closes ring
+void ConnectionXillybus::StopRing(int epIndex)
+{
+    StreamReader& reader = readers[epIndex];
+    reader.ringFailed = false;
+    if (!reader.ring.IsReady())
+        return;
+    reader.terminate.store(true);
+    if (reader.ringInFlight > 0)
+    {
+        //cancelling poll at head of chain cancels linked reads, reads themselves do not block
+        io_uring_sqe* sqe = reader.ring.GetSqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = POLL_TAG;
+        sqe->user_data = CANCEL_TAG;
+        reader.ring.Submit();
+        auto t1 = chrono::high_resolution_clock::now();
+        while (reader.ringInFlight > 0 && chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - t1).count() < 1000)
+        {
+            WaitForDescriptor(reader.ring.GetFd(), POLLIN, t1, 1000);
+            ReapRing(epIndex);
+        }
+    }
+    reader.ring.Destroy();
+    reader.ringInFlight = 0;
+    reader.fixedBuffers.clear();
+}
+
+/** @brief Allocates page aligned stream buffer and remembers it, so that stream
+    endpoint rings can register it and read into it without mapping its pages
+    for every read
+*/
+char* ConnectionXillybus::AllocateStreamBuffer(size_t length)
+{
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, 4096, length) != 0)
+        return nullptr;
+    iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = length;
+    std::lock_guard<std::mutex> lck(streamBuffersLock);
+    streamBuffers.push_back(iov);
+    return static_cast<char*>(buffer);
 }
 
+void ConnectionXillybus::FreeStreamBuffer(char* buffer, size_t)
+{
+    {
+        std::lock_guard<std::mutex> lck(streamBuffersLock);
+        for (auto iter = streamBuffers.begin(); iter != streamBuffers.end(); ++iter)
+            if (iter->iov_base == buffer)
+            {
+                streamBuffers.erase(iter);
+                break;
+            }
+    }
+    free(buffer);
+}
+#endif
+#endif
+
 /**
     @brief Aborts reading operations
 */
@@ -530,6 +845,7 @@ void ConnectionXillybus::AbortReading(int epIndex)
 	hReadStream[epIndex] = INVALID_HANDLE_VALUE;
     }
 #else
+    StopStreamReader(epIndex);
     if (hReadStream[epIndex] >= 0)
     {
         close(hReadStream[epIndex]);
@@ -602,10 +918,14 @@ int ConnectionXillybus::SendData(const char *buffer, int length, int epIndex, in
         int bytesSent;
         if ((bytesSent  = write(hWriteStream[epIndex], buffer+ totalBytesWritten, bytesToWrite))<0)
         {
-            if(errno == EINTR || errno == EAGAIN)
-                continue;
-            ReportError(errno);
-            return totalBytesWritten;
+            if (errno == EAGAIN)
+                WaitForDescriptor(hWriteStream[epIndex], POLLOUT, t1, timeout_ms);
+            else if (errno != EINTR)
+            {
+                ReportError(errno);
+                return totalBytesWritten;
+            }
+            continue;
         }
 #endif
         totalBytesWritten += bytesSent;
@@ -648,28 +968,121 @@ void ConnectionXillybus::AbortSending(int epIndex)
 #endif
 }
 
+/**
+    @brief Queues buffer to be filled by io_uring or reader thread of endpoint
+    @param buffer array where to store received data
+    @param length number of bytes to read
+    @param ep endpoint index
+    @return handle of read context, -1 on failure
+*/
 int ConnectionXillybus::BeginDataReading(char* buffer, uint32_t length, int ep)
 {
+#ifdef __unix__
+    if (OpenReadStream(ep) != 0)
+        return -1;
+    StreamReader& reader = readers[ep];
+    std::unique_lock<std::mutex> lck(reader.lock);
+    for (int i = 0; i < MAX_READ_CONTEXTS; ++i)
+    {
+        ReadContext& context = reader.contexts[i];
+        if (context.used)
+            continue;
+        context.buffer = buffer;
+        context.length = length;
+        context.bytesRead = 0;
+        context.used = true;
+        context.done = false;
+        reader.requests.push_back(i);
+#ifdef XILLYBUS_IO_URING
+        if (reader.ring.IsReady() || (!reader.ringFailed && !reader.thread.joinable() && StartRing(ep)))
+        {
+            SubmitRingReads(ep);
+            return ep*MAX_READ_CONTEXTS + i;
+        }
+#endif
+        if (!reader.thread.joinable())
+        {
+            reader.terminate.store(false);
+            reader.thread = std::thread(&ConnectionXillybus::ReadStreamLoop, this, ep);
+        }
+        lck.unlock();
+        reader.hasRequests.notify_one();
+        return ep*MAX_READ_CONTEXTS + i;
+    }
+    lime::error("No contexts left for reading data");
+    return -1;
+#else
     return ep;
+#endif
 }
+
 bool ConnectionXillybus::WaitForReading(int contextHandle, unsigned int timeout_ms)
 {
+#ifdef __unix__
+    if (contextHandle < 0)
+        return true;
+    const int ep = contextHandle / MAX_READ_CONTEXTS;
+    StreamReader& reader = readers[ep];
+    const ReadContext& context = reader.contexts[contextHandle % MAX_READ_CONTEXTS];
+    std::unique_lock<std::mutex> lck(reader.lock);
+#ifdef XILLYBUS_IO_URING
+    if (reader.ring.IsReady())
+    {
+        auto t1 = chrono::high_resolution_clock::now();
+        while (true)
+        {
+            ReapRing(ep);
+            if (!context.used || context.done)
+                return true;
+            if (chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - t1).count() >= int(timeout_ms))
+                return false;
+            WaitForDescriptor(reader.ring.GetFd(), POLLIN, t1, timeout_ms);
+        }
+    }
+#endif
+    return reader.hasResults.wait_for(lck, chrono::milliseconds(timeout_ms), [&context]{
+        return !context.used || context.done;});
+#else
     return true;
+#endif
 }
+
+/**
+    @brief Finishes read queued with BeginDataReading()
+    @return number of bytes received, 0 if read is not finished yet
+*/
 int ConnectionXillybus::FinishDataReading(char* buffer, uint32_t length, int contextHandle)
 {
+#ifdef __unix__
+    (void)buffer; //data is already in buffer given to BeginDataReading()
+    (void)length;
+    if (contextHandle < 0)
+        return -1;
+    StreamReader& reader = readers[contextHandle / MAX_READ_CONTEXTS];
+    ReadContext& context = reader.contexts[contextHandle % MAX_READ_CONTEXTS];
+    std::lock_guard<std::mutex> lck(reader.lock);
+#ifdef XILLYBUS_IO_URING
+    if (reader.ring.IsReady())
+        ReapRing(contextHandle / MAX_READ_CONTEXTS);
+#endif
+    if (!context.used || !context.done)
+        return 0;
+    context.used = false;
+    return context.bytesRead;
+#else
     return ReceiveData(buffer, length, contextHandle, 3000);
+#endif
 }
 
 int ConnectionXillybus::BeginDataSending(const char* buffer, uint32_t length, int ep)
 {
     return SendData(buffer, length,  ep, 3000);
 }
-bool ConnectionXillybus::WaitForSending(int contextHandle, uint32_t timeout_ms)
+bool ConnectionXillybus::WaitForSending(int, uint32_t)
 {
     return true;
 }
-int ConnectionXillybus::FinishDataSending(const char* buffer, uint32_t length, int contextHandle)
+int ConnectionXillybus::FinishDataSending(const char*, uint32_t, int contextHandle)
 {
     return contextHandle;
 }
@@ -19,6 +19,10 @@
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
+#include <deque>
+#ifdef XILLYBUS_IO_URING
+#include "IoUring.h"
+#endif
 #endif
 
 namespace lime{
@@ -42,6 +46,7 @@ public:
 #endif
 protected:
     int GetBuffersCount() const override;
+    int CheckBuffersCount(int count) const override;
     int CheckStreamSize(int size) const override;
 
     int ReceiveData(char* buffer, int length, int epIndex, int timeout = 100) override;
@@ -56,6 +61,10 @@ protected:
     bool WaitForSending(int contextHandle, uint32_t timeout_ms) override;
     int FinishDataSending(const char* buffer, uint32_t length, int contextHandle) override;
     void AbortSending(int epIndex);
+#ifdef XILLYBUS_IO_URING
+    char* AllocateStreamBuffer(size_t length) override;
+    void FreeStreamBuffer(char* buffer, size_t length) override;
+#endif
 private:
     friend class ConnectionXillybusEntry;
     static const int MAX_EP_CNT = 3;
@@ -88,6 +97,59 @@ private:
     int hRead;
     int hWriteStream[MAX_EP_CNT];
     int hReadStream[MAX_EP_CNT];
+
+    static const int MAX_READ_CONTEXTS = 16; //maximum number of queued stream reads per endpoint
+    static const int DEFAULT_READ_CONTEXTS = 4; //default number of queued stream reads
+
+    //! Stream read queued for reader thread of endpoint
+    struct ReadContext
+    {
+        ReadContext() : buffer(nullptr), length(0), bytesRead(0), used(false), done(false) {}
+        char* buffer;
+        uint32_t length;
+        int bytesRead;
+        bool used;
+        bool done;
+    };
+
+    //! Thread or io_uring reading stream endpoint into queued buffers ahead of their use
+    struct StreamReader
+    {
+#ifdef XILLYBUS_IO_URING
+        StreamReader() : terminate(false), ringInFlight(0), ringFailed(false) {}
+#else
+        StreamReader() : terminate(false) {}
+#endif
+        std::thread thread;
+        std::atomic<bool> terminate;
+        std::mutex lock;
+        std::condition_variable hasRequests;
+        std::condition_variable hasResults;
+        std::deque<int> requests;   //indexes of queued contexts in submission order
+        ReadContext contexts[MAX_READ_CONTEXTS];
+#ifdef XILLYBUS_IO_URING
+        IoUring ring;               //queues reads in kernel, used instead of thread if available
+        int ringInFlight;           //ring operations waiting for completion
+        bool ringFailed;            //ring setup failed, thread is used
+        std::vector<iovec> fixedBuffers; //buffers registered with ring
+#endif
+    };
+    StreamReader readers[MAX_EP_CNT];
+
+    int OpenReadStream(int epIndex);
+    int ReadStream(int epIndex, char* buffer, int length, int timeout_ms, const std::atomic<bool>* terminate = nullptr);
+    void ReadStreamLoop(int epIndex);
+    void StopStreamReader(int epIndex);
+#ifdef XILLYBUS_IO_URING
+    static const uint64_t POLL_TAG = MAX_READ_CONTEXTS;       //user_data of poll starting read chain
+    static const uint64_t CANCEL_TAG = MAX_READ_CONTEXTS + 1; //user_data of chain cancellation
+    bool StartRing(int epIndex);
+    void SubmitRingReads(int epIndex);
+    void ReapRing(int epIndex);
+    void StopRing(int epIndex);
+    std::mutex streamBuffersLock;
+    std::vector<iovec> streamBuffers; //buffers given out by AllocateStreamBuffer()
+#endif
 #endif
     std::string writeCtrlPort;
     std::string readCtrlPort;
@@ -0,0 +1,180 @@
+/**
+    @file IoUring.cpp
+    @author Lime Microsystems
+    @brief Minimal io_uring submission/completion ring on top of raw system calls.
+*/
+
+#include "IoUring.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include "Logger.h"
+
+using namespace lime;
+
+static int io_uring_setup(unsigned entries, io_uring_params* params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nrArgs)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+IoUring::IoUring() :
+    fd(-1),
+    sqRing(MAP_FAILED),
+    cqRing(MAP_FAILED),
+    sqRingSize(0),
+    cqRingSize(0),
+    sqes(static_cast<io_uring_sqe*>(MAP_FAILED)),
+    sqesCount(0),
+    sqHead(nullptr), sqTail(nullptr), sqMask(nullptr), sqArray(nullptr),
+    sqeTail(0),
+    sqeSubmitted(0),
+    cqHead(nullptr), cqTail(nullptr), cqMask(nullptr), cqes(nullptr)
+{
+}
+
+IoUring::~IoUring()
+{
+    Destroy();
+}
+
+/** @brief Creates ring and maps its queues
+    @param entries requested submission queue size
+    @return 0 on success, error code if io_uring is not available
+*/
+int IoUring::Init(unsigned entries)
+{
+    Destroy();
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    fd = io_uring_setup(entries, &params);
+    if (fd < 0)
+        return ReportError(errno, "io_uring setup failed: %s", strerror(errno));
+
+    sqRingSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+    const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing != MAP_FAILED)
+        cqRing = singleMmap ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cqRing != MAP_FAILED)
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, params.sq_entries*sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED)
+    {
+        const int err = errno;
+        Destroy();
+        return ReportError(err, "io_uring mmap failed: %s", strerror(err));
+    }
+    sqesCount = params.sq_entries;
+
+    char* sq = static_cast<char*>(sqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqeTail = sqeSubmitted = *sqTail;
+
+    char* cq = static_cast<char*>(cqRing);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return 0;
+}
+
+/** @brief Unmaps queues and closes ring, kernel cancels operations still in flight
+*/
+void IoUring::Destroy()
+{
+    if (sqes != MAP_FAILED)
+        munmap(sqes, sqesCount*sizeof(io_uring_sqe));
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+        munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED)
+        munmap(sqRing, sqRingSize);
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+    sqRing = cqRing = MAP_FAILED;
+    sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    sqesCount = 0;
+}
+
+/** @brief Registers buffers for IORING_OP_READ_FIXED/IORING_OP_WRITE_FIXED operations,
+    so that kernel does not map their pages for every operation
+    @return 0 on success, errno on failure (e.g. ENOMEM when exceeding RLIMIT_MEMLOCK)
+*/
+int IoUring::RegisterBuffers(const iovec* buffers, unsigned count)
+{
+    if (io_uring_register(fd, IORING_REGISTER_BUFFERS, buffers, count) < 0)
+        return errno;
+    return 0;
+}
+
+/** @brief Returns cleared submission queue entry, nullptr if queue is full
+*/
+io_uring_sqe* IoUring::GetSqe()
+{
+    const unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (sqeTail - head >= sqesCount)
+        return nullptr;
+    io_uring_sqe* sqe = &sqes[sqeTail & *sqMask];
+    memset(sqe, 0, sizeof(io_uring_sqe));
+    ++sqeTail;
+    return sqe;
+}
+
+/** @brief Passes entries taken with GetSqe() to kernel in one system call
+    @return number of entries submitted, -1 on failure
+*/
+int IoUring::Submit()
+{
+    const unsigned mask = *sqMask;
+    for (; sqeSubmitted != sqeTail; ++sqeSubmitted)
+        sqArray[sqeSubmitted & mask] = sqeSubmitted & mask;
+    __atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+
+    const unsigned pending = sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (pending == 0)
+        return 0;
+    int ret;
+    while ((ret = io_uring_enter(fd, pending, 0, 0)) < 0 && errno == EINTR);
+    if (ret < 0)
+    {
+        ReportError(errno, "io_uring submit failed: %s", strerror(errno));
+        return -1;
+    }
+    return ret;
+}
+
+/** @brief Takes next completion from completion queue without blocking
+    @param userData user_data of completed operation
+    @param result result of completed operation, negative errno on failure
+    @return true if completion was available
+*/
+bool IoUring::PopCompletion(uint64_t& userData, int32_t& result)
+{
+    const unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+        return false;
+    const io_uring_cqe& cqe = cqes[head & *cqMask];
+    userData = cqe.user_data;
+    result = cqe.res;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
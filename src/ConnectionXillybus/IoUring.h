@@ -0,0 +1,61 @@
+/**
+    @file IoUring.h
+    @author Lime Microsystems
+    @brief Minimal io_uring submission/completion ring on top of raw system calls.
+*/
+
+#pragma once
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <stdint.h>
+
+namespace lime{
+
+/** @brief Single-threaded io_uring instance.
+
+    Submission queue entries are taken with GetSqe(), filled by caller and
+    passed to kernel in one batch by Submit(). Completions are read directly
+    from shared completion ring by PopCompletion() without system calls, the
+    ring file descriptor becomes readable when completions are available.
+*/
+class IoUring
+{
+public:
+    IoUring();
+    ~IoUring();
+
+    int Init(unsigned entries);
+    void Destroy();
+    bool IsReady() const { return fd >= 0; }
+    int GetFd() const { return fd; }
+
+    int RegisterBuffers(const iovec* buffers, unsigned count);
+    io_uring_sqe* GetSqe();
+    int Submit();
+    bool PopCompletion(uint64_t& userData, int32_t& result);
+private:
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    int fd;
+    void* sqRing;
+    void* cqRing;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    io_uring_sqe* sqes;
+    unsigned sqesCount;
+
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned sqeTail;   //!< next entry to hand out by GetSqe()
+    unsigned sqeSubmitted; //!< entries up to this index are visible to kernel
+
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+};
+
+}
@@ -0,0 +1,1298 @@
+/**
+@file PacketCodec.cpp
+@author Lime Microsystems
+@brief Scalar and SIMD conversion between FPGA packet payload and complex samples
+*/
+
+#include "PacketCodec.h"
+#include "Logger.h"
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define LIME_CODEC_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LIME_TARGET(x)
+#else
+#define LIME_TARGET(x) __attribute__((target(x)))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define LIME_CODEC_NEON
+#include <arm_neon.h>
+#endif
+
+namespace lime
+{
+
+/***********************************************************************
+ * Scalar kernels
+ **********************************************************************/
+static int Unpack12Scalar(const uint8_t* buffer, int bufLen, complex16_t* dest)
+{
+    int16_t sample;
+    int collected = 0;
+    for(int b=0; b<bufLen;collected++)
+    {
+        //I sample
+        sample = buffer[b++];
+        sample |= (buffer[b] << 8);
+        sample <<= 4;
+        dest[collected].i = sample >> 4;
+        //Q sample
+        sample =  buffer[b++];
+        sample |= buffer[b++] << 8;
+        dest[collected].q = sample >> 4;
+    }
+    return collected;
+}
+
+static int Unpack12MimoScalar(const uint8_t* buffer, int bufLen, complex16_t* destA, complex16_t* destB)
+{
+    int collected = 0;
+    for(int b=0; b<bufLen;collected++)
+    {
+        Unpack12Scalar(&buffer[b], 3, &destA[collected]);
+        Unpack12Scalar(&buffer[b+3], 3, &destB[collected]);
+        b += 6;
+    }
+    return collected;
+}
+
+static int Deinterleave16Scalar(const complex16_t* src, int count, complex16_t* destA, complex16_t* destB)
+{
+    for(int i=0; i<count;i++)
+    {
+        destA[i] = *src++;
+        destB[i] = *src++;
+    }
+    return count;
+}
+
+static int Pack12Scalar(const complex16_t* src, int count, uint8_t* buffer)
+{
+    int b=0;
+    for(int i=0; i<count; ++i)
+    {
+        buffer[b++] = src[i].i;
+        buffer[b++] = ((src[i].i >> 8) & 0x0F) | (src[i].q << 4);
+        buffer[b++] = src[i].q >> 4;
+    }
+    return count;
+}
+
+static int Pack12MimoScalar(const complex16_t* srcA, const complex16_t* srcB, int count, uint8_t* buffer)
+{
+    for(int i=0; i<count; ++i)
+    {
+        Pack12Scalar(&srcA[i], 1, buffer);
+        Pack12Scalar(&srcB[i], 1, buffer+3);
+        buffer += 6;
+    }
+    return count;
+}
+
+static int Interleave16Scalar(const complex16_t* srcA, const complex16_t* srcB, int count, complex16_t* dest)
+{
+    for(int i=0; i<count; ++i)
+    {
+        *dest++ = srcA[i];
+        *dest++ = srcB[i];
+    }
+    return count;
+}
+
+static int ToFloatScalar(const complex16_t* src, int count, float* dest, float scale)
+{
+    for(int i=0; i<count; ++i)
+    {
+        dest[2*i] = src[i].i * scale;
+        dest[2*i+1] = src[i].q * scale;
+    }
+    return count;
+}
+
+static inline int16_t FromFloatClip(float value, float limit, bool& clipped)
+{
+    if (value != value) //NaN, lrintf() result is unspecified
+        return 0;
+    if (value > limit)
+    {
+        clipped = true;
+        value = limit;
+    }
+    else if (value < -limit-1)
+    {
+        clipped = true;
+        value = -limit-1;
+    }
+    return (int16_t)lrintf(value);
+}
+
+static int FromFloatScalar(const float* src, int count, complex16_t* dest, float scale, int16_t limit, uint32_t* clipped)
+{
+    for(int i=0; i<count; ++i)
+    {
+        bool clip = false;
+        dest[i].i = FromFloatClip(src[2*i] * scale, limit, clip);
+        dest[i].q = FromFloatClip(src[2*i+1] * scale, limit, clip);
+        *clipped += clip;
+    }
+    return count;
+}
+
+static int ToPlanar16Scalar(const complex16_t* src, int count, int16_t* destI, int16_t* destQ)
+{
+    for(int i=0; i<count; ++i)
+    {
+        destI[i] = src[i].i;
+        destQ[i] = src[i].q;
+    }
+    return count;
+}
+
+static int FromPlanar16Scalar(const int16_t* srcI, const int16_t* srcQ, int count, complex16_t* dest)
+{
+    for(int i=0; i<count; ++i)
+    {
+        dest[i].i = srcI[i];
+        dest[i].q = srcQ[i];
+    }
+    return count;
+}
+
+static int ToFloatPlanarScalar(const complex16_t* src, int count, float* destI, float* destQ, float scale)
+{
+    for(int i=0; i<count; ++i)
+    {
+        destI[i] = src[i].i * scale;
+        destQ[i] = src[i].q * scale;
+    }
+    return count;
+}
+
+static int FromFloatPlanarScalar(const float* srcI, const float* srcQ, int count, complex16_t* dest, float scale, int16_t limit, uint32_t* clipped)
+{
+    for(int i=0; i<count; ++i)
+    {
+        bool clip = false;
+        dest[i].i = FromFloatClip(srcI[i] * scale, limit, clip);
+        dest[i].q = FromFloatClip(srcQ[i] * scale, limit, clip);
+        *clipped += clip;
+    }
+    return count;
+}
+
+static inline int8_t SaturateInt8(int value)
+{
+    return value > 127 ? 127 : (value < -128 ? -128 : value);
+}
+
+static int Unpack8MimoScalar(const uint8_t* buffer, int bufLen, complex16_t* destA, complex16_t* destB)
+{
+    const int8_t* src = (const int8_t*)buffer;
+    int collected = 0;
+    for(int b=0; b+4<=bufLen; b+=4, ++collected)
+    {
+        destA[collected].i = src[b];
+        destA[collected].q = src[b+1];
+        destB[collected].i = src[b+2];
+        destB[collected].q = src[b+3];
+    }
+    return collected;
+}
+
+static int Pack8MimoScalar(const complex16_t* srcA, const complex16_t* srcB, int count, uint8_t* buffer)
+{
+    int8_t* dest = (int8_t*)buffer;
+    for(int i=0; i<count; ++i)
+    {
+        *dest++ = SaturateInt8(srcA[i].i);
+        *dest++ = SaturateInt8(srcA[i].q);
+        *dest++ = SaturateInt8(srcB[i].i);
+        *dest++ = SaturateInt8(srcB[i].q);
+    }
+    return count;
+}
+
+static int ToInt8Scalar(const complex16_t* src, int count, int8_t* dest, int shift)
+{
+    for(int i=0; i<count; ++i)
+    {
+        dest[2*i] = SaturateInt8(src[i].i >> shift);
+        dest[2*i+1] = SaturateInt8(src[i].q >> shift);
+    }
+    return count;
+}
+
+static int FromInt8Scalar(const int8_t* src, int count, complex16_t* dest, int shift)
+{
+    for(int i=0; i<count; ++i)
+    {
+        dest[i].i = src[2*i] << shift;
+        dest[i].q = src[2*i+1] << shift;
+    }
+    return count;
+}
+
+//! @brief Counts pairs of set bits in 8 bit mask, i.e. complex samples with I or Q clipped
+static inline int CountClipped(int mask)
+{
+    int x = (mask | (mask >> 1)) & 0x55;
+    x = (x & 0x33) + ((x >> 2) & 0x33);
+    return (x & 0x0F) + (x >> 4);
+}
+
+//! @brief Counts set bits in 8 bit mask
+static inline int CountBits(int mask)
+{
+    int x = (mask & 0x55) + ((mask >> 1) & 0x55);
+    x = (x & 0x33) + ((x >> 2) & 0x33);
+    return (x & 0x0F) + (x >> 4);
+}
+
+static const PacketCodec scalarCodec = {
+    "scalar",
+    Unpack12Scalar, Unpack12MimoScalar, Deinterleave16Scalar,
+    Pack12Scalar, Pack12MimoScalar, Interleave16Scalar,
+    ToFloatScalar, FromFloatScalar,
+    ToPlanar16Scalar, FromPlanar16Scalar,
+    ToFloatPlanarScalar, FromFloatPlanarScalar,
+    Unpack8MimoScalar, Pack8MimoScalar,
+    ToInt8Scalar, FromInt8Scalar
+};
+
+#ifdef LIME_CODEC_X86
+/***********************************************************************
+ * SSE4.1 kernels
+ * 12 bit samples: 3 bytes are spread to I and Q 16 bit lanes by byte shuffle,
+ * I lanes are sign extended by shifting left and back right, Q lanes by
+ * arithmetic shift right. Packing goes in reverse order.
+ **********************************************************************/
+LIME_TARGET("sse4.1")
+static inline __m128i Unpack12x4SSE(const uint8_t* src)
+{
+    const __m128i shuffle = _mm_setr_epi8(0,1, 1,2, 3,4, 4,5, 6,7, 7,8, 9,10, 10,11);
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), shuffle);
+    __m128i i = _mm_srai_epi16(_mm_slli_epi16(v, 4), 4);
+    __m128i q = _mm_srai_epi16(v, 4);
+    return _mm_blend_epi16(i, q, 0xAA);
+}
+
+LIME_TARGET("sse4.1")
+static int Unpack12SSE(const uint8_t* buffer, int bufLen, complex16_t* dest)
+{
+    int i = 0;
+    for(; 3*i+16 <= bufLen; i+=4)
+        _mm_storeu_si128((__m128i*)&dest[i], Unpack12x4SSE(&buffer[3*i]));
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int Unpack12MimoSSE(const uint8_t* buffer, int bufLen, complex16_t* destA, complex16_t* destB)
+{
+    int i = 0;
+    for(; 6*i+16 <= bufLen; i+=2)
+    {
+        __m128i v = _mm_shuffle_epi32(Unpack12x4SSE(&buffer[6*i]), _MM_SHUFFLE(3,1,2,0));
+        _mm_storel_epi64((__m128i*)&destA[i], v);
+        _mm_storel_epi64((__m128i*)&destB[i], _mm_unpackhi_epi64(v, v));
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int Deinterleave16SSE(const complex16_t* src, int count, complex16_t* destA, complex16_t* destB)
+{
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        __m128i v0 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&src[2*i]), _MM_SHUFFLE(3,1,2,0));
+        __m128i v1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&src[2*i+4]), _MM_SHUFFLE(3,1,2,0));
+        _mm_storeu_si128((__m128i*)&destA[i], _mm_unpacklo_epi64(v0, v1));
+        _mm_storeu_si128((__m128i*)&destB[i], _mm_unpackhi_epi64(v0, v1));
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static inline __m128i Pack12x4SSE(__m128i v)
+{
+    const __m128i shuffle = _mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+    v = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0x000FFF)),
+                     _mm_and_si128(_mm_srli_epi32(v, 4), _mm_set1_epi32(0xFFF000)));
+    return _mm_shuffle_epi8(v, shuffle);
+}
+
+//each store writes 4 bytes past packed samples, they are overwritten by next store
+LIME_TARGET("sse4.1")
+static int Pack12SSE(const complex16_t* src, int count, uint8_t* buffer)
+{
+    int i = 0;
+    for(; i+6 <= count; i+=4)
+        _mm_storeu_si128((__m128i*)&buffer[3*i], Pack12x4SSE(_mm_loadu_si128((const __m128i*)&src[i])));
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int Pack12MimoSSE(const complex16_t* srcA, const complex16_t* srcB, int count, uint8_t* buffer)
+{
+    int i = 0;
+    for(; i+3 <= count; i+=2)
+    {
+        __m128i v = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i*)&srcA[i]), _mm_loadl_epi64((const __m128i*)&srcB[i]));
+        _mm_storeu_si128((__m128i*)&buffer[6*i], Pack12x4SSE(v));
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int Interleave16SSE(const complex16_t* srcA, const complex16_t* srcB, int count, complex16_t* dest)
+{
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)&srcA[i]);
+        __m128i b = _mm_loadu_si128((const __m128i*)&srcB[i]);
+        _mm_storeu_si128((__m128i*)&dest[2*i], _mm_unpacklo_epi32(a, b));
+        _mm_storeu_si128((__m128i*)&dest[2*i+4], _mm_unpackhi_epi32(a, b));
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int ToFloatSSE(const complex16_t* src, int count, float* dest, float scale)
+{
+    const __m128 k = _mm_set1_ps(scale);
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(v)), k);
+        __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_unpackhi_epi64(v, v))), k);
+        _mm_storeu_ps(&dest[2*i], lo);
+        _mm_storeu_ps(&dest[2*i+4], hi);
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int FromFloatSSE(const float* src, int count, complex16_t* dest, float scale, int16_t limit, uint32_t* clipped)
+{
+    const __m128 k = _mm_set1_ps(scale);
+    const __m128 hiLimit = _mm_set1_ps(limit);
+    const __m128 loLimit = _mm_set1_ps(-limit-1);
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(&src[2*i]), k);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(&src[2*i+4]), k);
+        //zero NaN lanes, max/min would turn them into lower limit
+        a = _mm_and_ps(a, _mm_cmpord_ps(a, a));
+        b = _mm_and_ps(b, _mm_cmpord_ps(b, b));
+        int mask = _mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(a, hiLimit), _mm_cmplt_ps(a, loLimit)));
+        mask |= _mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(b, hiLimit), _mm_cmplt_ps(b, loLimit))) << 4;
+        *clipped += CountClipped(mask);
+        __m128i ia = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(a, loLimit), hiLimit));
+        __m128i ib = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(b, loLimit), hiLimit));
+        _mm_storeu_si128((__m128i*)&dest[i], _mm_packs_epi32(ia, ib));
+    }
+    return i;
+}
+
+//! Gathers I values of 4 samples to lower and Q values to upper half of register
+LIME_TARGET("sse4.1")
+static inline __m128i SplitIQx4SSE(const complex16_t* src)
+{
+    const __m128i shuffle = _mm_setr_epi8(0,1, 4,5, 8,9, 12,13, 2,3, 6,7, 10,11, 14,15);
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), shuffle);
+}
+
+LIME_TARGET("sse4.1")
+static int ToPlanar16SSE(const complex16_t* src, int count, int16_t* destI, int16_t* destQ)
+{
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m128i v0 = SplitIQx4SSE(&src[i]);
+        __m128i v1 = SplitIQx4SSE(&src[i+4]);
+        _mm_storeu_si128((__m128i*)&destI[i], _mm_unpacklo_epi64(v0, v1));
+        _mm_storeu_si128((__m128i*)&destQ[i], _mm_unpackhi_epi64(v0, v1));
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int FromPlanar16SSE(const int16_t* srcI, const int16_t* srcQ, int count, complex16_t* dest)
+{
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m128i vi = _mm_loadu_si128((const __m128i*)&srcI[i]);
+        __m128i vq = _mm_loadu_si128((const __m128i*)&srcQ[i]);
+        _mm_storeu_si128((__m128i*)&dest[i], _mm_unpacklo_epi16(vi, vq));
+        _mm_storeu_si128((__m128i*)&dest[i+4], _mm_unpackhi_epi16(vi, vq));
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int ToFloatPlanarSSE(const complex16_t* src, int count, float* destI, float* destQ, float scale)
+{
+    const __m128 k = _mm_set1_ps(scale);
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        __m128i v = SplitIQx4SSE(&src[i]);
+        _mm_storeu_ps(&destI[i], _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(v)), k));
+        _mm_storeu_ps(&destQ[i], _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_unpackhi_epi64(v, v))), k));
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int FromFloatPlanarSSE(const float* srcI, const float* srcQ, int count, complex16_t* dest, float scale, int16_t limit, uint32_t* clipped)
+{
+    const __m128 k = _mm_set1_ps(scale);
+    const __m128 hiLimit = _mm_set1_ps(limit);
+    const __m128 loLimit = _mm_set1_ps(-limit-1);
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(&srcI[i]), k);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(&srcQ[i]), k);
+        //zero NaN lanes, max/min would turn them into lower limit
+        a = _mm_and_ps(a, _mm_cmpord_ps(a, a));
+        b = _mm_and_ps(b, _mm_cmpord_ps(b, b));
+        __m128 clip = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(a, hiLimit), _mm_cmplt_ps(a, loLimit)),
+                                _mm_or_ps(_mm_cmpgt_ps(b, hiLimit), _mm_cmplt_ps(b, loLimit)));
+        *clipped += CountBits(_mm_movemask_ps(clip));
+        __m128i ia = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(a, loLimit), hiLimit));
+        __m128i ib = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(b, loLimit), hiLimit));
+        _mm_storeu_si128((__m128i*)&dest[i], _mm_packs_epi32(_mm_unpacklo_epi32(ia, ib), _mm_unpackhi_epi32(ia, ib)));
+    }
+    return i;
+}
+
+/* 8 bit samples are sign extended to 16 bits and packed back with saturation.
+ * In MIMO payload each 4 bytes hold sample of channel A followed by channel B.
+ */
+LIME_TARGET("sse4.1")
+static int Unpack8MimoSSE(const uint8_t* buffer, int bufLen, complex16_t* destA, complex16_t* destB)
+{
+    int i = 0;
+    for(; 4*i+16 <= bufLen; i+=4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)&buffer[4*i]);
+        __m128i v0 = _mm_shuffle_epi32(_mm_cvtepi8_epi16(v), _MM_SHUFFLE(3,1,2,0));
+        __m128i v1 = _mm_shuffle_epi32(_mm_cvtepi8_epi16(_mm_unpackhi_epi64(v, v)), _MM_SHUFFLE(3,1,2,0));
+        _mm_storeu_si128((__m128i*)&destA[i], _mm_unpacklo_epi64(v0, v1));
+        _mm_storeu_si128((__m128i*)&destB[i], _mm_unpackhi_epi64(v0, v1));
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int Pack8MimoSSE(const complex16_t* srcA, const complex16_t* srcB, int count, uint8_t* buffer)
+{
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)&srcA[i]);
+        __m128i b = _mm_loadu_si128((const __m128i*)&srcB[i]);
+        _mm_storeu_si128((__m128i*)&buffer[4*i], _mm_packs_epi16(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b)));
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int ToInt8SSE(const complex16_t* src, int count, int8_t* dest, int shift)
+{
+    const __m128i k = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m128i a = _mm_sra_epi16(_mm_loadu_si128((const __m128i*)&src[i]), k);
+        __m128i b = _mm_sra_epi16(_mm_loadu_si128((const __m128i*)&src[i+4]), k);
+        _mm_storeu_si128((__m128i*)&dest[2*i], _mm_packs_epi16(a, b));
+    }
+    return i;
+}
+
+LIME_TARGET("sse4.1")
+static int FromInt8SSE(const int8_t* src, int count, complex16_t* dest, int shift)
+{
+    const __m128i k = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)&src[2*i]);
+        _mm_storeu_si128((__m128i*)&dest[i], _mm_sll_epi16(_mm_cvtepi8_epi16(v), k));
+        _mm_storeu_si128((__m128i*)&dest[i+4], _mm_sll_epi16(_mm_cvtepi8_epi16(_mm_unpackhi_epi64(v, v)), k));
+    }
+    return i;
+}
+
+static const PacketCodec sse41Codec = {
+    "SSE4.1",
+    Unpack12SSE, Unpack12MimoSSE, Deinterleave16SSE,
+    Pack12SSE, Pack12MimoSSE, Interleave16SSE,
+    ToFloatSSE, FromFloatSSE,
+    ToPlanar16SSE, FromPlanar16SSE,
+    ToFloatPlanarSSE, FromFloatPlanarSSE,
+    Unpack8MimoSSE, Pack8MimoSSE,
+    ToInt8SSE, FromInt8SSE
+};
+
+/***********************************************************************
+ * AVX2 kernels, same as SSE4.1 with two 128 bit lanes
+ **********************************************************************/
+LIME_TARGET("avx2")
+static inline __m256i Unpack12x8AVX2(const uint8_t* src)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0,1, 1,2, 3,4, 4,5, 6,7, 7,8, 9,10, 10,11,
+                                             0,1, 1,2, 3,4, 4,5, 6,7, 7,8, 9,10, 10,11);
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)src)),
+                                        _mm_loadu_si128((const __m128i*)(src+12)), 1);
+    v = _mm256_shuffle_epi8(v, shuffle);
+    __m256i i = _mm256_srai_epi16(_mm256_slli_epi16(v, 4), 4);
+    __m256i q = _mm256_srai_epi16(v, 4);
+    return _mm256_blend_epi16(i, q, 0xAA);
+}
+
+LIME_TARGET("avx2")
+static int Unpack12AVX2(const uint8_t* buffer, int bufLen, complex16_t* dest)
+{
+    int i = 0;
+    for(; 3*i+28 <= bufLen; i+=8)
+        _mm256_storeu_si256((__m256i*)&dest[i], Unpack12x8AVX2(&buffer[3*i]));
+    return i + Unpack12SSE(&buffer[3*i], bufLen-3*i, &dest[i]);
+}
+
+LIME_TARGET("avx2")
+static int Unpack12MimoAVX2(const uint8_t* buffer, int bufLen, complex16_t* destA, complex16_t* destB)
+{
+    const __m256i order = _mm256_setr_epi32(0,2,4,6, 1,3,5,7);
+    int i = 0;
+    for(; 6*i+28 <= bufLen; i+=4)
+    {
+        __m256i v = _mm256_permutevar8x32_epi32(Unpack12x8AVX2(&buffer[6*i]), order);
+        _mm_storeu_si128((__m128i*)&destA[i], _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)&destB[i], _mm256_extracti128_si256(v, 1));
+    }
+    return i + Unpack12MimoSSE(&buffer[6*i], bufLen-6*i, &destA[i], &destB[i]);
+}
+
+LIME_TARGET("avx2")
+static int Deinterleave16AVX2(const complex16_t* src, int count, complex16_t* destA, complex16_t* destB)
+{
+    const __m256i order = _mm256_setr_epi32(0,2,4,6, 1,3,5,7);
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m256i v0 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)&src[2*i]), order);
+        __m256i v1 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)&src[2*i+8]), order);
+        _mm256_storeu_si256((__m256i*)&destA[i], _mm256_permute2x128_si256(v0, v1, 0x20));
+        _mm256_storeu_si256((__m256i*)&destB[i], _mm256_permute2x128_si256(v0, v1, 0x31));
+    }
+    return i + Deinterleave16SSE(&src[2*i], count-i, &destA[i], &destB[i]);
+}
+
+LIME_TARGET("avx2")
+static inline __m256i Pack12x8AVX2(__m256i v)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1,
+                                             0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+    v = _mm256_or_si256(_mm256_and_si256(v, _mm256_set1_epi32(0x000FFF)),
+                        _mm256_and_si256(_mm256_srli_epi32(v, 4), _mm256_set1_epi32(0xFFF000)));
+    return _mm256_shuffle_epi8(v, shuffle);
+}
+
+//each store writes 4 bytes past packed samples, they are overwritten by next store
+LIME_TARGET("avx2")
+static int Pack12AVX2(const complex16_t* src, int count, uint8_t* buffer)
+{
+    int i = 0;
+    for(; i+10 <= count; i+=8)
+    {
+        __m256i v = Pack12x8AVX2(_mm256_loadu_si256((const __m256i*)&src[i]));
+        _mm_storeu_si128((__m128i*)&buffer[3*i], _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)&buffer[3*i+12], _mm256_extracti128_si256(v, 1));
+    }
+    return i + Pack12SSE(&src[i], count-i, &buffer[3*i]);
+}
+
+LIME_TARGET("avx2")
+static int Pack12MimoAVX2(const complex16_t* srcA, const complex16_t* srcB, int count, uint8_t* buffer)
+{
+    int i = 0;
+    for(; i+5 <= count; i+=4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)&srcA[i]);
+        __m128i b = _mm_loadu_si128((const __m128i*)&srcB[i]);
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi32(a, b)), _mm_unpackhi_epi32(a, b), 1);
+        v = Pack12x8AVX2(v);
+        _mm_storeu_si128((__m128i*)&buffer[6*i], _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)&buffer[6*i+12], _mm256_extracti128_si256(v, 1));
+    }
+    return i + Pack12MimoSSE(&srcA[i], &srcB[i], count-i, &buffer[6*i]);
+}
+
+LIME_TARGET("avx2")
+static int Interleave16AVX2(const complex16_t* srcA, const complex16_t* srcB, int count, complex16_t* dest)
+{
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)&srcA[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i*)&srcB[i]);
+        __m256i lo = _mm256_unpacklo_epi32(a, b);
+        __m256i hi = _mm256_unpackhi_epi32(a, b);
+        _mm256_storeu_si256((__m256i*)&dest[2*i], _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)&dest[2*i+8], _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return i + Interleave16SSE(&srcA[i], &srcB[i], count-i, &dest[2*i]);
+}
+
+LIME_TARGET("avx2")
+static int ToFloatAVX2(const complex16_t* src, int count, float* dest, float scale)
+{
+    const __m256 k = _mm256_set1_ps(scale);
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m128i lo = _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128i hi = _mm_loadu_si128((const __m128i*)&src[i+4]);
+        _mm256_storeu_ps(&dest[2*i], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(lo)), k));
+        _mm256_storeu_ps(&dest[2*i+8], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(hi)), k));
+    }
+    return i + ToFloatSSE(&src[i], count-i, &dest[2*i], scale);
+}
+
+LIME_TARGET("avx2")
+static int FromFloatAVX2(const float* src, int count, complex16_t* dest, float scale, int16_t limit, uint32_t* clipped)
+{
+    const __m256 k = _mm256_set1_ps(scale);
+    const __m256 hiLimit = _mm256_set1_ps(limit);
+    const __m256 loLimit = _mm256_set1_ps(-limit-1);
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(&src[2*i]), k);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(&src[2*i+8]), k);
+        //zero NaN lanes, max/min would turn them into lower limit
+        a = _mm256_and_ps(a, _mm256_cmp_ps(a, a, _CMP_ORD_Q));
+        b = _mm256_and_ps(b, _mm256_cmp_ps(b, b, _CMP_ORD_Q));
+        *clipped += CountClipped(_mm256_movemask_ps(_mm256_or_ps(_mm256_cmp_ps(a, hiLimit, _CMP_GT_OQ), _mm256_cmp_ps(a, loLimit, _CMP_LT_OQ))));
+        *clipped += CountClipped(_mm256_movemask_ps(_mm256_or_ps(_mm256_cmp_ps(b, hiLimit, _CMP_GT_OQ), _mm256_cmp_ps(b, loLimit, _CMP_LT_OQ))));
+        __m256i ia = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(a, loLimit), hiLimit));
+        __m256i ib = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(b, loLimit), hiLimit));
+        //pack works within 128 bit lanes, restore sample order
+        __m256i v = _mm256_permute4x64_epi64(_mm256_packs_epi32(ia, ib), 0xD8);
+        _mm256_storeu_si256((__m256i*)&dest[i], v);
+    }
+    return i + FromFloatSSE(&src[2*i], count-i, &dest[i], scale, limit, clipped);
+}
+
+//! Gathers I values of 8 samples to lower and Q values to upper 128 bit lane
+LIME_TARGET("avx2")
+static inline __m256i SplitIQx8AVX2(const complex16_t* src)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0,1, 4,5, 8,9, 12,13, 2,3, 6,7, 10,11, 14,15,
+                                             0,1, 4,5, 8,9, 12,13, 2,3, 6,7, 10,11, 14,15);
+    __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)src), shuffle);
+    return _mm256_permute4x64_epi64(v, 0xD8);
+}
+
+LIME_TARGET("avx2")
+static int ToPlanar16AVX2(const complex16_t* src, int count, int16_t* destI, int16_t* destQ)
+{
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m256i v = SplitIQx8AVX2(&src[i]);
+        _mm_storeu_si128((__m128i*)&destI[i], _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)&destQ[i], _mm256_extracti128_si256(v, 1));
+    }
+    return i;
+}
+
+LIME_TARGET("avx2")
+static int FromPlanar16AVX2(const int16_t* srcI, const int16_t* srcQ, int count, complex16_t* dest)
+{
+    int i = 0;
+    for(; i+16 <= count; i+=16)
+    {
+        __m256i vi = _mm256_loadu_si256((const __m256i*)&srcI[i]);
+        __m256i vq = _mm256_loadu_si256((const __m256i*)&srcQ[i]);
+        __m256i lo = _mm256_unpacklo_epi16(vi, vq);
+        __m256i hi = _mm256_unpackhi_epi16(vi, vq);
+        _mm256_storeu_si256((__m256i*)&dest[i], _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)&dest[i+8], _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return i + FromPlanar16SSE(&srcI[i], &srcQ[i], count-i, &dest[i]);
+}
+
+LIME_TARGET("avx2")
+static int ToFloatPlanarAVX2(const complex16_t* src, int count, float* destI, float* destQ, float scale)
+{
+    const __m256 k = _mm256_set1_ps(scale);
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m256i v = SplitIQx8AVX2(&src[i]);
+        _mm256_storeu_ps(&destI[i], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v))), k));
+        _mm256_storeu_ps(&destQ[i], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1))), k));
+    }
+    return i + ToFloatPlanarSSE(&src[i], count-i, &destI[i], &destQ[i], scale);
+}
+
+LIME_TARGET("avx2")
+static int FromFloatPlanarAVX2(const float* srcI, const float* srcQ, int count, complex16_t* dest, float scale, int16_t limit, uint32_t* clipped)
+{
+    const __m256 k = _mm256_set1_ps(scale);
+    const __m256 hiLimit = _mm256_set1_ps(limit);
+    const __m256 loLimit = _mm256_set1_ps(-limit-1);
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(&srcI[i]), k);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(&srcQ[i]), k);
+        //zero NaN lanes, max/min would turn them into lower limit
+        a = _mm256_and_ps(a, _mm256_cmp_ps(a, a, _CMP_ORD_Q));
+        b = _mm256_and_ps(b, _mm256_cmp_ps(b, b, _CMP_ORD_Q));
+        __m256 clip = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(a, hiLimit, _CMP_GT_OQ), _mm256_cmp_ps(a, loLimit, _CMP_LT_OQ)),
+                                   _mm256_or_ps(_mm256_cmp_ps(b, hiLimit, _CMP_GT_OQ), _mm256_cmp_ps(b, loLimit, _CMP_LT_OQ)));
+        *clipped += CountBits(_mm256_movemask_ps(clip));
+        __m256i ia = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(a, loLimit), hiLimit));
+        __m256i ib = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(b, loLimit), hiLimit));
+        //unpack and pack both work within 128 bit lanes, so sample order is preserved
+        __m256i v = _mm256_packs_epi32(_mm256_unpacklo_epi32(ia, ib), _mm256_unpackhi_epi32(ia, ib));
+        _mm256_storeu_si256((__m256i*)&dest[i], v);
+    }
+    return i + FromFloatPlanarSSE(&srcI[i], &srcQ[i], count-i, &dest[i], scale, limit, clipped);
+}
+
+LIME_TARGET("avx2")
+static int ToInt8AVX2(const complex16_t* src, int count, int8_t* dest, int shift)
+{
+    const __m128i k = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for(; i+16 <= count; i+=16)
+    {
+        __m256i a = _mm256_sra_epi16(_mm256_loadu_si256((const __m256i*)&src[i]), k);
+        __m256i b = _mm256_sra_epi16(_mm256_loadu_si256((const __m256i*)&src[i+8]), k);
+        //pack works within 128 bit lanes, restore sample order
+        _mm256_storeu_si256((__m256i*)&dest[2*i], _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8));
+    }
+    return i + ToInt8SSE(&src[i], count-i, &dest[2*i], shift);
+}
+
+LIME_TARGET("avx2")
+static int FromInt8AVX2(const int8_t* src, int count, complex16_t* dest, int shift)
+{
+    const __m128i k = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for(; i+16 <= count; i+=16)
+    {
+        __m128i lo = _mm_loadu_si128((const __m128i*)&src[2*i]);
+        __m128i hi = _mm_loadu_si128((const __m128i*)&src[2*i+16]);
+        _mm256_storeu_si256((__m256i*)&dest[i], _mm256_sll_epi16(_mm256_cvtepi8_epi16(lo), k));
+        _mm256_storeu_si256((__m256i*)&dest[i+8], _mm256_sll_epi16(_mm256_cvtepi8_epi16(hi), k));
+    }
+    return i + FromInt8SSE(&src[2*i], count-i, &dest[i], shift);
+}
+
+static const PacketCodec avx2Codec = {
+    "AVX2",
+    Unpack12AVX2, Unpack12MimoAVX2, Deinterleave16AVX2,
+    Pack12AVX2, Pack12MimoAVX2, Interleave16AVX2,
+    ToFloatAVX2, FromFloatAVX2,
+    ToPlanar16AVX2, FromPlanar16AVX2,
+    ToFloatPlanarAVX2, FromFloatPlanarAVX2,
+    Unpack8MimoSSE, Pack8MimoSSE,
+    ToInt8AVX2, FromInt8AVX2
+};
+
+static bool CpuSupports(const char* feature)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    const bool sse41 = (info[2] & (1 << 19)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (strcmp(feature, "sse4.1") == 0)
+        return sse41;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return strcmp(feature, "avx2") == 0 && (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    if (strcmp(feature, "sse4.1") == 0)
+        return __builtin_cpu_supports("sse4.1");
+    if (strcmp(feature, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    return false;
+#endif
+}
+#endif // LIME_CODEC_X86
+
+#ifdef LIME_CODEC_NEON
+/***********************************************************************
+ * NEON kernels
+ * 12 bit samples are loaded with 3-way deinterleaving load, so that first,
+ * second and third byte of each sample end up in separate registers.
+ **********************************************************************/
+static inline void Unpack12x16NEON(const uint8_t* src, int16x8x2_t& i, int16x8x2_t& q)
+{
+    uint8x16x3_t v = vld3q_u8(src);
+    uint8x16x2_t iBytes = vzipq_u8(v.val[0], v.val[1]);
+    uint8x16x2_t qBytes = vzipq_u8(v.val[1], v.val[2]);
+    for (int k = 0; k < 2; ++k)
+    {
+        i.val[k] = vshrq_n_s16(vshlq_n_s16(vreinterpretq_s16_u8(iBytes.val[k]), 4), 4);
+        q.val[k] = vshrq_n_s16(vreinterpretq_s16_u8(qBytes.val[k]), 4);
+    }
+}
+
+static int Unpack12NEON(const uint8_t* buffer, int bufLen, complex16_t* dest)
+{
+    int i = 0;
+    for(; 3*i+48 <= bufLen; i+=16)
+    {
+        int16x8x2_t iv, qv;
+        Unpack12x16NEON(&buffer[3*i], iv, qv);
+        int16x8x2_t lo = {{iv.val[0], qv.val[0]}};
+        int16x8x2_t hi = {{iv.val[1], qv.val[1]}};
+        vst2q_s16((int16_t*)&dest[i], lo);
+        vst2q_s16((int16_t*)&dest[i+8], hi);
+    }
+    return i;
+}
+
+static int Unpack12MimoNEON(const uint8_t* buffer, int bufLen, complex16_t* destA, complex16_t* destB)
+{
+    int i = 0;
+    for(; 6*i+48 <= bufLen; i+=8)
+    {
+        int16x8x2_t iv, qv;
+        Unpack12x16NEON(&buffer[6*i], iv, qv);
+        int16x8x2_t iAB = vuzpq_s16(iv.val[0], iv.val[1]);
+        int16x8x2_t qAB = vuzpq_s16(qv.val[0], qv.val[1]);
+        int16x8x2_t a = {{iAB.val[0], qAB.val[0]}};
+        int16x8x2_t b = {{iAB.val[1], qAB.val[1]}};
+        vst2q_s16((int16_t*)&destA[i], a);
+        vst2q_s16((int16_t*)&destB[i], b);
+    }
+    return i;
+}
+
+static int Deinterleave16NEON(const complex16_t* src, int count, complex16_t* destA, complex16_t* destB)
+{
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        uint32x4x2_t v = vld2q_u32((const uint32_t*)&src[2*i]);
+        vst1q_u32((uint32_t*)&destA[i], v.val[0]);
+        vst1q_u32((uint32_t*)&destB[i], v.val[1]);
+    }
+    return i;
+}
+
+static inline void Pack12x16NEON(const int16x8x2_t& i, const int16x8x2_t& q, uint8_t* dest)
+{
+    uint8x16x3_t v;
+    uint16x8_t b1[2], b2[2];
+    for (int k = 0; k < 2; ++k)
+    {
+        uint16x8_t iu = vreinterpretq_u16_s16(i.val[k]);
+        uint16x8_t qu = vreinterpretq_u16_s16(q.val[k]);
+        b1[k] = vorrq_u16(vandq_u16(vshrq_n_u16(iu, 8), vdupq_n_u16(0x0F)), vshlq_n_u16(qu, 4));
+        b2[k] = vshrq_n_u16(qu, 4);
+    }
+    v.val[0] = vcombine_u8(vmovn_u16(vreinterpretq_u16_s16(i.val[0])), vmovn_u16(vreinterpretq_u16_s16(i.val[1])));
+    v.val[1] = vcombine_u8(vmovn_u16(b1[0]), vmovn_u16(b1[1]));
+    v.val[2] = vcombine_u8(vmovn_u16(b2[0]), vmovn_u16(b2[1]));
+    vst3q_u8(dest, v);
+}
+
+static int Pack12NEON(const complex16_t* src, int count, uint8_t* buffer)
+{
+    int i = 0;
+    for(; i+16 <= count; i+=16)
+    {
+        int16x8x2_t lo = vld2q_s16((const int16_t*)&src[i]);
+        int16x8x2_t hi = vld2q_s16((const int16_t*)&src[i+8]);
+        int16x8x2_t iv = {{lo.val[0], hi.val[0]}};
+        int16x8x2_t qv = {{lo.val[1], hi.val[1]}};
+        Pack12x16NEON(iv, qv, &buffer[3*i]);
+    }
+    return i;
+}
+
+static int Pack12MimoNEON(const complex16_t* srcA, const complex16_t* srcB, int count, uint8_t* buffer)
+{
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        int16x8x2_t a = vld2q_s16((const int16_t*)&srcA[i]);
+        int16x8x2_t b = vld2q_s16((const int16_t*)&srcB[i]);
+        int16x8x2_t iv = vzipq_s16(a.val[0], b.val[0]);
+        int16x8x2_t qv = vzipq_s16(a.val[1], b.val[1]);
+        Pack12x16NEON(iv, qv, &buffer[6*i]);
+    }
+    return i;
+}
+
+static int Interleave16NEON(const complex16_t* srcA, const complex16_t* srcB, int count, complex16_t* dest)
+{
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        uint32x4x2_t v;
+        v.val[0] = vld1q_u32((const uint32_t*)&srcA[i]);
+        v.val[1] = vld1q_u32((const uint32_t*)&srcB[i]);
+        vst2q_u32((uint32_t*)&dest[2*i], v);
+    }
+    return i;
+}
+
+static int ToFloatNEON(const complex16_t* src, int count, float* dest, float scale)
+{
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        int16x8_t v = vld1q_s16((const int16_t*)&src[i]);
+        vst1q_f32(&dest[2*i], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(&dest[2*i+4], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+    return i;
+}
+
+static inline int32x4_t FromFloatx4NEON(float32x4_t v)
+{
+#ifdef __aarch64__
+    return vcvtnq_s32_f32(v);
+#else
+    //no round to nearest conversion on ARMv7, adding 1.5*2^23 rounds values below 2^22
+    //to integer half to even like lrintf(), subtracting it leaves exact integer to truncate
+    const float32x4_t magic = vdupq_n_f32(12582912.0f);
+    return vcvtq_s32_f32(vsubq_f32(vaddq_f32(v, magic), magic));
+#endif
+}
+
+static int FromFloatNEON(const float* src, int count, complex16_t* dest, float scale, int16_t limit, uint32_t* clipped)
+{
+    const float32x4_t hiLimit = vdupq_n_f32(limit);
+    const float32x4_t loLimit = vdupq_n_f32(-limit-1);
+    uint32x4_t clipCount = vdupq_n_u32(0);
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        float32x4_t a = vmulq_n_f32(vld1q_f32(&src[2*i]), scale);
+        float32x4_t b = vmulq_n_f32(vld1q_f32(&src[2*i+4]), scale);
+        //zero NaN lanes, same as scalar codec
+        a = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vceqq_f32(a, a)));
+        b = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(b), vceqq_f32(b, b)));
+        uint32x4_t ma = vorrq_u32(vcgtq_f32(a, hiLimit), vcltq_f32(a, loLimit));
+        uint32x4_t mb = vorrq_u32(vcgtq_f32(b, hiLimit), vcltq_f32(b, loLimit));
+        //spread clip flag to both I and Q lanes, mask lanes are all ones, so subtracting counts them
+        clipCount = vsubq_u32(clipCount, vorrq_u32(ma, vrev64q_u32(ma)));
+        clipCount = vsubq_u32(clipCount, vorrq_u32(mb, vrev64q_u32(mb)));
+        int32x4_t ia = FromFloatx4NEON(vminq_f32(vmaxq_f32(a, loLimit), hiLimit));
+        int32x4_t ib = FromFloatx4NEON(vminq_f32(vmaxq_f32(b, loLimit), hiLimit));
+        vst1q_s16((int16_t*)&dest[i], vcombine_s16(vqmovn_s32(ia), vqmovn_s32(ib)));
+    }
+    *clipped += (vgetq_lane_u32(clipCount, 0) + vgetq_lane_u32(clipCount, 1) +
+                 vgetq_lane_u32(clipCount, 2) + vgetq_lane_u32(clipCount, 3)) / 2;
+    return i;
+}
+
+static int ToPlanar16NEON(const complex16_t* src, int count, int16_t* destI, int16_t* destQ)
+{
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        int16x8x2_t v = vld2q_s16((const int16_t*)&src[i]);
+        vst1q_s16(&destI[i], v.val[0]);
+        vst1q_s16(&destQ[i], v.val[1]);
+    }
+    return i;
+}
+
+static int FromPlanar16NEON(const int16_t* srcI, const int16_t* srcQ, int count, complex16_t* dest)
+{
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        int16x8x2_t v = {{vld1q_s16(&srcI[i]), vld1q_s16(&srcQ[i])}};
+        vst2q_s16((int16_t*)&dest[i], v);
+    }
+    return i;
+}
+
+static int ToFloatPlanarNEON(const complex16_t* src, int count, float* destI, float* destQ, float scale)
+{
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        int16x8x2_t v = vld2q_s16((const int16_t*)&src[i]);
+        vst1q_f32(&destI[i], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[0]))), scale));
+        vst1q_f32(&destI[i+4], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[0]))), scale));
+        vst1q_f32(&destQ[i], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[1]))), scale));
+        vst1q_f32(&destQ[i+4], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[1]))), scale));
+    }
+    return i;
+}
+
+static int FromFloatPlanarNEON(const float* srcI, const float* srcQ, int count, complex16_t* dest, float scale, int16_t limit, uint32_t* clipped)
+{
+    const float32x4_t hiLimit = vdupq_n_f32(limit);
+    const float32x4_t loLimit = vdupq_n_f32(-limit-1);
+    uint32x4_t clipCount = vdupq_n_u32(0);
+    int i = 0;
+    for(; i+4 <= count; i+=4)
+    {
+        float32x4_t a = vmulq_n_f32(vld1q_f32(&srcI[i]), scale);
+        float32x4_t b = vmulq_n_f32(vld1q_f32(&srcQ[i]), scale);
+        //zero NaN lanes, same as scalar codec
+        a = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vceqq_f32(a, a)));
+        b = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(b), vceqq_f32(b, b)));
+        uint32x4_t ma = vorrq_u32(vcgtq_f32(a, hiLimit), vcltq_f32(a, loLimit));
+        uint32x4_t mb = vorrq_u32(vcgtq_f32(b, hiLimit), vcltq_f32(b, loLimit));
+        //mask lanes are all ones, so subtracting counts them
+        clipCount = vsubq_u32(clipCount, vorrq_u32(ma, mb));
+        int32x4_t ia = FromFloatx4NEON(vminq_f32(vmaxq_f32(a, loLimit), hiLimit));
+        int32x4_t ib = FromFloatx4NEON(vminq_f32(vmaxq_f32(b, loLimit), hiLimit));
+        int16x4x2_t v = {{vqmovn_s32(ia), vqmovn_s32(ib)}};
+        vst2_s16((int16_t*)&dest[i], v);
+    }
+    *clipped += vgetq_lane_u32(clipCount, 0) + vgetq_lane_u32(clipCount, 1) +
+                vgetq_lane_u32(clipCount, 2) + vgetq_lane_u32(clipCount, 3);
+    return i;
+}
+
+//MIMO payload is loaded as 16 bit units, so that each channel I/Q byte pairs end up in separate registers
+static int Unpack8MimoNEON(const uint8_t* buffer, int bufLen, complex16_t* destA, complex16_t* destB)
+{
+    int i = 0;
+    for(; 4*i+32 <= bufLen; i+=8)
+    {
+        int16x8x2_t v = vld2q_s16((const int16_t*)&buffer[4*i]);
+        int8x16_t a = vreinterpretq_s8_s16(v.val[0]);
+        int8x16_t b = vreinterpretq_s8_s16(v.val[1]);
+        vst1q_s16((int16_t*)&destA[i], vmovl_s8(vget_low_s8(a)));
+        vst1q_s16((int16_t*)&destA[i+4], vmovl_s8(vget_high_s8(a)));
+        vst1q_s16((int16_t*)&destB[i], vmovl_s8(vget_low_s8(b)));
+        vst1q_s16((int16_t*)&destB[i+4], vmovl_s8(vget_high_s8(b)));
+    }
+    return i;
+}
+
+static int Pack8MimoNEON(const complex16_t* srcA, const complex16_t* srcB, int count, uint8_t* buffer)
+{
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        int8x16_t a = vcombine_s8(vqmovn_s16(vld1q_s16((const int16_t*)&srcA[i])), vqmovn_s16(vld1q_s16((const int16_t*)&srcA[i+4])));
+        int8x16_t b = vcombine_s8(vqmovn_s16(vld1q_s16((const int16_t*)&srcB[i])), vqmovn_s16(vld1q_s16((const int16_t*)&srcB[i+4])));
+        int16x8x2_t v = {{vreinterpretq_s16_s8(a), vreinterpretq_s16_s8(b)}};
+        vst2q_s16((int16_t*)&buffer[4*i], v);
+    }
+    return i;
+}
+
+static int ToInt8NEON(const complex16_t* src, int count, int8_t* dest, int shift)
+{
+    const int16x8_t k = vdupq_n_s16(-shift);
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        int16x8_t a = vshlq_s16(vld1q_s16((const int16_t*)&src[i]), k);
+        int16x8_t b = vshlq_s16(vld1q_s16((const int16_t*)&src[i+4]), k);
+        vst1q_s8(&dest[2*i], vcombine_s8(vqmovn_s16(a), vqmovn_s16(b)));
+    }
+    return i;
+}
+
+static int FromInt8NEON(const int8_t* src, int count, complex16_t* dest, int shift)
+{
+    const int16x8_t k = vdupq_n_s16(shift);
+    int i = 0;
+    for(; i+8 <= count; i+=8)
+    {
+        int8x16_t v = vld1q_s8(&src[2*i]);
+        vst1q_s16((int16_t*)&dest[i], vshlq_s16(vmovl_s8(vget_low_s8(v)), k));
+        vst1q_s16((int16_t*)&dest[i+4], vshlq_s16(vmovl_s8(vget_high_s8(v)), k));
+    }
+    return i;
+}
+
+static const PacketCodec neonCodec = {
+    "NEON",
+    Unpack12NEON, Unpack12MimoNEON, Deinterleave16NEON,
+    Pack12NEON, Pack12MimoNEON, Interleave16NEON,
+    ToFloatNEON, FromFloatNEON,
+    ToPlanar16NEON, FromPlanar16NEON,
+    ToFloatPlanarNEON, FromFloatPlanarNEON,
+    Unpack8MimoNEON, Pack8MimoNEON,
+    ToInt8NEON, FromInt8NEON
+};
+#endif // LIME_CODEC_NEON
+
+static const PacketCodec& SelectPacketCodec()
+{
+    const PacketCodec* codec = &scalarCodec;
+#if defined(LIME_CODEC_X86)
+    if (CpuSupports("avx2"))
+        codec = &avx2Codec;
+    else if (CpuSupports("sse4.1"))
+        codec = &sse41Codec;
+#elif defined(LIME_CODEC_NEON)
+    codec = &neonCodec;
+#endif
+    lime::debug("Packet codec: %s", codec->name);
+    return *codec;
+}
+
+const PacketCodec& GetPacketCodec()
+{
+    static const PacketCodec& codec = SelectPacketCodec();
+    return codec;
+}
+
+const PacketCodec& GetScalarPacketCodec()
+{
+    return scalarCodec;
+}
+
+int PayloadToSamples(const PacketCodec& codec, const uint8_t* buffer, int bufLen, bool mimo, bool compressed, complex16_t** samples)
+{
+    if(compressed) //compressed samples
+    {
+        if (mimo)
+        {
+            const int done = codec.unpack12mimo(buffer, bufLen, samples[0], samples[1]);
+            return done + Unpack12MimoScalar(&buffer[6*done], bufLen-6*done, &samples[0][done], &samples[1][done]);
+        }
+        const int done = codec.unpack12(buffer, bufLen, samples[0]);
+        return done + Unpack12Scalar(&buffer[3*done], bufLen-3*done, &samples[0][done]);
+    }
+
+    if (mimo) //uncompressed samples
+    {
+        const complex16_t* ptr = (const complex16_t*)buffer;
+        const int collected = bufLen/sizeof(complex16_t)/2;
+        const int done = codec.deinterleave16(ptr, collected, samples[0], samples[1]);
+        Deinterleave16Scalar(&ptr[2*done], collected-done, &samples[0][done], &samples[1][done]);
+        return collected;
+    }
+
+    memcpy(samples[0],buffer,bufLen);
+    return bufLen/sizeof(complex16_t);
+}
+
+int SamplesToPayload(const PacketCodec& codec, const complex16_t* const* samples, int samplesCount, bool mimo, bool compressed, uint8_t* buffer)
+{
+    if(compressed)
+    {
+        if (mimo)
+        {
+            const int done = codec.pack12mimo(samples[0], samples[1], samplesCount, buffer);
+            Pack12MimoScalar(&samples[0][done], &samples[1][done], samplesCount-done, &buffer[6*done]);
+            return samplesCount*6;
+        }
+        const int done = codec.pack12(samples[0], samplesCount, buffer);
+        Pack12Scalar(&samples[0][done], samplesCount-done, &buffer[3*done]);
+        return samplesCount*3;
+    }
+
+    if (mimo)
+    {
+        complex16_t* ptr = (complex16_t*)buffer;
+        const int done = codec.interleave16(samples[0], samples[1], samplesCount, ptr);
+        Interleave16Scalar(&samples[0][done], &samples[1][done], samplesCount-done, &ptr[2*done]);
+        return samplesCount*2*sizeof(complex16_t);
+    }
+    memcpy(buffer,samples[0],samplesCount*sizeof(complex16_t));
+    return samplesCount*sizeof(complex16_t);
+}
+
+int Payload8ToSamples(const PacketCodec& codec, const uint8_t* buffer, int bufLen, bool mimo, complex16_t** samples)
+{
+    if (mimo)
+    {
+        const int done = codec.unpack8mimo(buffer, bufLen, samples[0], samples[1]);
+        return done + Unpack8MimoScalar(&buffer[4*done], bufLen-4*done, &samples[0][done], &samples[1][done]);
+    }
+    Int8ToSamples(codec, (const int8_t*)buffer, bufLen/2, samples[0], 0);
+    return bufLen/2;
+}
+
+int SamplesToPayload8(const PacketCodec& codec, const complex16_t* const* samples, int samplesCount, bool mimo, uint8_t* buffer)
+{
+    if (mimo)
+    {
+        const int done = codec.pack8mimo(samples[0], samples[1], samplesCount, buffer);
+        Pack8MimoScalar(&samples[0][done], &samples[1][done], samplesCount-done, &buffer[4*done]);
+        return samplesCount*4;
+    }
+    SamplesToInt8(codec, samples[0], samplesCount, (int8_t*)buffer, 0);
+    return samplesCount*2;
+}
+
+void SamplesToFloat(const PacketCodec& codec, const complex16_t* src, int count, float* dest, float scale)
+{
+    const int done = codec.toFloat(src, count, dest, scale);
+    ToFloatScalar(&src[done], count-done, &dest[2*done], scale);
+}
+
+int FloatToSamples(const PacketCodec& codec, const float* src, int count, complex16_t* dest, float scale, int16_t limit)
+{
+    uint32_t clipped = 0;
+    const int done = codec.fromFloat(src, count, dest, scale, limit, &clipped);
+    FromFloatScalar(&src[2*done], count-done, &dest[done], scale, limit, &clipped);
+    return clipped;
+}
+
+void SamplesToPlanar(const PacketCodec& codec, const complex16_t* src, int count, int16_t* destI, int16_t* destQ)
+{
+    const int done = codec.toPlanar16(src, count, destI, destQ);
+    ToPlanar16Scalar(&src[done], count-done, &destI[done], &destQ[done]);
+}
+
+void PlanarToSamples(const PacketCodec& codec, const int16_t* srcI, const int16_t* srcQ, int count, complex16_t* dest)
+{
+    const int done = codec.fromPlanar16(srcI, srcQ, count, dest);
+    FromPlanar16Scalar(&srcI[done], &srcQ[done], count-done, &dest[done]);
+}
+
+void SamplesToFloatPlanar(const PacketCodec& codec, const complex16_t* src, int count, float* destI, float* destQ, float scale)
+{
+    const int done = codec.toFloatPlanar(src, count, destI, destQ, scale);
+    ToFloatPlanarScalar(&src[done], count-done, &destI[done], &destQ[done], scale);
+}
+
+int FloatPlanarToSamples(const PacketCodec& codec, const float* srcI, const float* srcQ, int count, complex16_t* dest, float scale, int16_t limit)
+{
+    uint32_t clipped = 0;
+    const int done = codec.fromFloatPlanar(srcI, srcQ, count, dest, scale, limit, &clipped);
+    FromFloatPlanarScalar(&srcI[done], &srcQ[done], count-done, &dest[done], scale, limit, &clipped);
+    return clipped;
+}
+
+void SamplesToInt8(const PacketCodec& codec, const complex16_t* src, int count, int8_t* dest, int shift)
+{
+    const int done = codec.toInt8(src, count, dest, shift);
+    ToInt8Scalar(&src[done], count-done, &dest[2*done], shift);
+}
+
+void Int8ToSamples(const PacketCodec& codec, const int8_t* src, int count, complex16_t* dest, int shift)
+{
+    const int done = codec.fromInt8(src, count, dest, shift);
+    FromInt8Scalar(&src[2*done], count-done, &dest[done], shift);
+}
+
+}
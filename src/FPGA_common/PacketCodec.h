@@ -0,0 +1,77 @@
+/**
+@file PacketCodec.h
+@author Lime Microsystems
+@brief Conversion between FPGA packet payload and complex samples
+*/
+
+#ifndef PACKET_CODEC_H
+#define PACKET_CODEC_H
+#include <stdint.h>
+#include "dataTypes.h"
+
+namespace lime
+{
+
+/** @brief Set of packet payload conversion kernels.
+    Kernels return the number of samples per channel they have processed,
+    the remaining samples are handled by the scalar code.
+*/
+struct PacketCodec
+{
+    const char* name;
+    int (*unpack12)(const uint8_t* buffer, int bufLen, complex16_t* dest);
+    int (*unpack12mimo)(const uint8_t* buffer, int bufLen, complex16_t* destA, complex16_t* destB);
+    int (*deinterleave16)(const complex16_t* src, int count, complex16_t* destA, complex16_t* destB);
+    int (*pack12)(const complex16_t* src, int count, uint8_t* buffer);
+    int (*pack12mimo)(const complex16_t* srcA, const complex16_t* srcB, int count, uint8_t* buffer);
+    int (*interleave16)(const complex16_t* srcA, const complex16_t* srcB, int count, complex16_t* dest);
+    int (*toFloat)(const complex16_t* src, int count, float* dest, float scale);
+    int (*fromFloat)(const float* src, int count, complex16_t* dest, float scale, int16_t limit, uint32_t* clipped);
+    int (*toPlanar16)(const complex16_t* src, int count, int16_t* destI, int16_t* destQ);
+    int (*fromPlanar16)(const int16_t* srcI, const int16_t* srcQ, int count, complex16_t* dest);
+    int (*toFloatPlanar)(const complex16_t* src, int count, float* destI, float* destQ, float scale);
+    int (*fromFloatPlanar)(const float* srcI, const float* srcQ, int count, complex16_t* dest, float scale, int16_t limit, uint32_t* clipped);
+    int (*unpack8mimo)(const uint8_t* buffer, int bufLen, complex16_t* destA, complex16_t* destB);
+    int (*pack8mimo)(const complex16_t* srcA, const complex16_t* srcB, int count, uint8_t* buffer);
+    int (*toInt8)(const complex16_t* src, int count, int8_t* dest, int shift);
+    int (*fromInt8)(const int8_t* src, int count, complex16_t* dest, int shift);
+};
+
+//! @brief Returns the fastest conversion kernels supported by the running CPU
+const PacketCodec& GetPacketCodec();
+
+//! @brief Returns scalar conversion kernels
+const PacketCodec& GetScalarPacketCodec();
+
+int PayloadToSamples(const PacketCodec& codec, const uint8_t* buffer, int bufLen, bool mimo, bool compressed, complex16_t** samples);
+int SamplesToPayload(const PacketCodec& codec, const complex16_t* const* samples, int samplesCount, bool mimo, bool compressed, uint8_t* buffer);
+
+//! @brief Converts payload of 8 bit link samples, returns number of samples per channel
+int Payload8ToSamples(const PacketCodec& codec, const uint8_t* buffer, int bufLen, bool mimo, complex16_t** samples);
+//! @brief Converts samples to payload of 8 bit link samples, returns payload size in bytes
+int SamplesToPayload8(const PacketCodec& codec, const complex16_t* const* samples, int samplesCount, bool mimo, uint8_t* buffer);
+void SamplesToFloat(const PacketCodec& codec, const complex16_t* src, int count, float* dest, float scale);
+
+/** @brief Converts float samples to integers, saturating them to [-limit-1, limit] range
+    @return number of complex samples that had I or Q value clipped
+*/
+int FloatToSamples(const PacketCodec& codec, const float* src, int count, complex16_t* dest, float scale, int16_t limit);
+
+//! @brief Splits complex samples to separate I and Q arrays
+void SamplesToPlanar(const PacketCodec& codec, const complex16_t* src, int count, int16_t* destI, int16_t* destQ);
+//! @brief Merges separate I and Q arrays to complex samples
+void PlanarToSamples(const PacketCodec& codec, const int16_t* srcI, const int16_t* srcQ, int count, complex16_t* dest);
+void SamplesToFloatPlanar(const PacketCodec& codec, const complex16_t* src, int count, float* destI, float* destQ, float scale);
+
+/** @brief Converts separate float I and Q arrays to integer samples, saturating them to [-limit-1, limit] range
+    @return number of complex samples that had I or Q value clipped
+*/
+int FloatPlanarToSamples(const PacketCodec& codec, const float* srcI, const float* srcQ, int count, complex16_t* dest, float scale, int16_t limit);
+
+//! @brief Converts samples to 8 bit complex values, shifting them right by shift bits with saturation
+void SamplesToInt8(const PacketCodec& codec, const complex16_t* src, int count, int8_t* dest, int shift);
+//! @brief Converts 8 bit complex values to samples, shifting them left by shift bits
+void Int8ToSamples(const PacketCodec& codec, const int8_t* src, int count, complex16_t* dest, int shift);
+
+}
+#endif // PACKET_CODEC_H
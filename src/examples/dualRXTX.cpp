@@ -143,7 +143,7 @@ int main(int argc, char** argv)
 
     lms_stream_meta_t rx_metadata; //Use metadata for additional control over sample receive function behavior
     rx_metadata.flushPartialPacket = false; //currently has no effect in RX
-    rx_metadata.waitForTimestamp = false; //currently has no effect in RX
+    rx_metadata.waitForTimestamp = false; //true would drop samples received before rx_metadata.timestamp
 
     lms_stream_meta_t tx_metadata; //Use metadata for additional control over sample send function behavior
     tx_metadata.flushPartialPacket = false; //do not force sending of incomplete packet
@@ -444,6 +444,7 @@ void fftviewer_frFFTviewer::StreamingLoop(fftviewer_frFFTviewer* pthis, const un
         {
             uint32_t samplesPopped[cMaxChCount];
             uint64_t ts[cMaxChCount];
+            meta.waitForTimestamp = false; //Rx reads continuously, timestamp is used for Tx
             for(int i=0; i<channelsCount; ++i)
             {
                 samplesPopped[i] = LMS_RecvStream(&pthis->rxStreams[i], &buffers[i][0], fftSize, &meta, 1000);
@@ -1030,7 +1030,8 @@ typedef struct
 
     /**In TX: wait for the specified HW timestamp before broadcasting data over
      * the air
-     * In RX: not used/ignored
+     * In RX: drop samples older than the specified timestamp without copying
+     * them, so that returned buffer starts at the timestamp
      */
     bool waitForTimestamp;
 
@@ -1039,6 +1040,12 @@ typedef struct
      */
     bool flushPartialPacket;
 
+    /**In RX: set when returned samples do not follow previously received
+     * samples, see ::LMS_STREAM_GAP_SPLIT
+     * In TX: not used/ignored
+     */
+    bool discontinuity;
+
 }lms_stream_meta_t;
 
 /**
@@ -1050,6 +1057,25 @@ typedef struct
  */
 ///Attempt to align channel phases in MIMO mode (supported only for Rx channels)
 #define LMS_ALIGN_CH_PHASE (1<<16)
+///Apply worker thread settings from lms_stream_t::threadCpuMask and following fields
+#define LMS_STREAM_THREAD_CFG (1<<17)
+///Adjust link transfer size and count while streaming, decisions are logged
+#define LMS_STREAM_AUTO_TUNE (1<<18)
+///Apply Tx burst settings from lms_stream_t::burstLeadTime and lms_stream_t::dropLateBursts
+#define LMS_STREAM_BURST_CFG (1<<19)
+///Stream channel and the next one (channel must be even) through one FIFO,
+///samples are transferred with LMS_RecvStreamMulti() and LMS_SendStreamMulti()
+#define LMS_STREAM_JOINT (1<<20)
+///Create event file descriptor, see lms_stream_t::eventThreshold and LMS_GetStreamFd()
+#define LMS_STREAM_EVENT_FD (1<<21)
+///Apply Rx FIFO overflow settings from lms_stream_t::overflowPolicy and lms_stream_t::overflowBlockTime
+#define LMS_STREAM_OVERFLOW_CFG (1<<22)
+///Rx: return zero samples in place of lost samples, see LMS_GetStreamGap()
+#define LMS_STREAM_GAP_ZERO_FILL (1<<23)
+///Rx: end read at lost samples, next read sets lms_stream_meta_t::discontinuity
+#define LMS_STREAM_GAP_SPLIT (1<<24)
+///Apply link transfer settings from lms_stream_t::linkTransfers and lms_stream_t::linkTransferSize
+#define LMS_STREAM_LINK_CFG (1<<25)
 /** @} (End STREAM_CH_FLAGS) */
 
 /**Stream structure*/
@@ -1084,10 +1110,125 @@ typedef struct
     {
         LMS_FMT_F32=0,    ///<32-bit floating point
         LMS_FMT_I16,      ///<16-bit integers
-        LMS_FMT_I12       ///<12-bit integers stored in 16-bit variables
+        LMS_FMT_I12,      ///<12-bit integers stored in 16-bit variables
+        LMS_FMT_I16_PLANAR, ///<16-bit integers, all I values followed by all Q values
+        LMS_FMT_F32_PLANAR  ///<32-bit floating point, all I values followed by all Q values
     }dataFmt;
+
+    /** @brief
+     * CPUs (0-63) the stream worker thread is allowed to run on, 0 - no restriction.
+     * This and following fields are used only if channel is combined with
+     * ::LMS_STREAM_THREAD_CFG flag. Rx and Tx worker threads are shared by
+     * channels, settings of the first channel requesting them are used.*/
+    uint64_t threadCpuMask;
+
+    //! Stream worker thread scheduling policy
+    enum
+    {
+        LMS_SCHED_DEFAULT=0,  ///<OS default time sharing
+        LMS_SCHED_FIFO,       ///<SCHED_FIFO real-time scheduling
+        LMS_SCHED_RR          ///<SCHED_RR real-time scheduling
+    }threadPolicy;
+
+    //! Stream worker thread priority for real-time scheduling policies
+    int threadPriority;
+
+    //! Stream worker thread name, NULL for default
+    const char* threadName;
+
+    /** @brief
+     * Minimum time (s) between current hardware time and start of Tx burst
+     * for the burst to be considered on time. This and following field are
+     * used only if channel is combined with ::LMS_STREAM_BURST_CFG flag.*/
+    float burstLeadTime;
+
+    //! Drop late Tx bursts instead of only reporting them
+    bool dropLateBursts;
+
+    /** @brief
+     * Number of samples that can be read (Rx) or written (Tx) for stream event
+     * descriptor to become readable. Used only if channel is combined with
+     * ::LMS_STREAM_EVENT_FD flag, 0 selects 1 sample.*/
+    uint32_t eventThreshold;
+
+    /** @brief
+     * Handling of received samples when Rx FIFO is full. This and following
+     * field are used only if channel is combined with ::LMS_STREAM_OVERFLOW_CFG
+     * flag. Dropped samples are reported by LMS_GetStreamGap().*/
+    enum
+    {
+        LMS_OVERFLOW_DROP_OLDEST=0, ///<drop the oldest samples in FIFO
+        LMS_OVERFLOW_DROP_NEWEST,   ///<drop the received samples
+        LMS_OVERFLOW_BLOCK          ///<wait for space up to overflowBlockTime, then drop the received samples
+    }overflowPolicy;
+
+    //! Longest wait (ms) for Rx FIFO space with LMS_OVERFLOW_BLOCK, delays all Rx channels
+    uint32_t overflowBlockTime;
+
+    /** @brief
+     * Number of link transfers kept in flight, 0 for default. This and following
+     * field are used only if channel is combined with ::LMS_STREAM_LINK_CFG flag
+     * and apply to all channels of the same direction.*/
+    uint32_t linkTransfers;
+
+    //! Size of a link transfer (bytes), rounded down to whole packets, at most 1 MiB, 0 for default
+    uint32_t linkTransferSize;
 }lms_stream_t;
 
+/**Received packets handed to stream callback, see LMS_SetStreamCallback()*/
+typedef struct
+{
+    ///Number of packets in batch
+    unsigned packetCount;
+    ///Samples of each packet, 16-bit interleaved I/Q in link format range
+    ///(12-bit range when stream uses ::LMS_FMT_I12), as in LMS_RecvStreamAcquire()
+    const int16_t* const* samples;
+    ///Number of samples per channel in each packet
+    const uint32_t* sampleCount;
+    ///Timestamp of the first sample of each packet
+    const uint64_t* timestamp;
+    ///Offset (in samples) of the second channel in ::LMS_STREAM_JOINT stream packets
+    unsigned channelStride;
+}lms_stream_batch_t;
+
+/**
+ * Stream callback, called from stream worker thread.
+ * Batch and its samples are valid only during the call.
+ */
+typedef void (*lms_stream_cb_t)(lms_stream_t *stream, const lms_stream_batch_t *batch, void *userData);
+
+/**Range of lost Rx samples, see LMS_GetStreamGap()*/
+typedef struct
+{
+    ///Timestamp of the first lost sample
+    uint64_t timestamp;
+    ///Number of lost samples per channel
+    uint32_t sampleCount;
+    ///Reason samples were lost
+    enum
+    {
+        LMS_GAP_LINK=0,     ///<packets lost on link or dropped by FPGA
+        LMS_GAP_OVERFLOW    ///<samples dropped by host FIFO overflow policy
+    }cause;
+}lms_stream_gap_t;
+
+/**Tx burst event, see LMS_GetTxBurstEvent()*/
+typedef struct
+{
+    //! Event type
+    enum
+    {
+        LMS_BURST_ACK=0,  ///<burst was handed to link
+        LMS_BURST_LATE    ///<burst start was behind hardware time plus lead time
+    }type;
+    ///Timestamp of the first burst sample
+    uint64_t timestamp;
+    ///Hardware timestamp when event was generated
+    uint64_t time;
+    ///Burst was dropped without sending it
+    bool dropped;
+}lms_burst_event_t;
+
 /**Streaming status structure*/
 typedef struct
 {
@@ -1109,6 +1250,8 @@ typedef struct
     float_type linkRate;
     ///The most recently received Rx timestamp, or the last timestamp submitted to Tx.
     uint64_t timestamp;
+    ///Number of Rx gap records waiting to be read with LMS_GetStreamGap()
+    uint32_t gapCount;
 
 } lms_stream_status_t;
 
@@ -1154,6 +1297,8 @@ API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream);
 /**
  * Read samples from the FIFO of the specified stream.
  * Sample buffer must be big enough to hold requested number of samples.
+ * With planar data formats Q values start at sample_count offset in buffer,
+ * even if fewer samples are received.
  *
  * @param stream        structure previously initialized with LMS_SetupStream().
  * @param samples       sample buffer.
@@ -1166,6 +1311,110 @@ API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream);
  API_EXPORT int CALL_CONV LMS_RecvStream(lms_stream_t *stream, void *samples,
              size_t sample_count, lms_stream_meta_t *meta, unsigned timeout_ms);
 
+/**
+ * Read samples of all channels of joint stream (::LMS_STREAM_JOINT) in one call.
+ * All buffers receive the same number of samples with the same start timestamp.
+ * Can also be used with single channel streams, passing one buffer.
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param samples       array of sample buffers, one per stream channel.
+ * @param sample_count  Number of samples to read to each buffer
+ * @param meta          Metadata. See the ::lms_stream_meta_t description.
+ * @param timeout_ms    how long to wait for data before timing out.
+ *
+ * @return number of samples received to each buffer on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_RecvStreamMulti(lms_stream_t *stream, void **samples,
+             size_t sample_count, lms_stream_meta_t *meta, unsigned timeout_ms);
+
+/**
+ * Attach additional reader to Rx stream. Each reader receives all samples of
+ * the stream independently of LMS_RecvStream() and other readers, starting
+ * with the next received packet. Readers never stall the receive thread:
+ * reader falling behind by more than FIFO size loses samples, or is dropped
+ * when dropWhenLagging is set.
+ *
+ * @param stream            Rx stream previously initialized with LMS_SetupStream().
+ * @param dropWhenLagging   stop reader when it falls behind, instead of skipping lost samples
+ *
+ * @return reader index on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_AttachStreamReader(lms_stream_t *stream, bool dropWhenLagging);
+
+/**
+ * Remove reader attached with LMS_AttachStreamReader().
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param reader    reader index returned by LMS_AttachStreamReader().
+ *
+ * @return 0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_DetachStreamReader(lms_stream_t *stream, int reader);
+
+/**
+ * Read stream samples through reader attached with LMS_AttachStreamReader().
+ * Each reader must be used from one thread. Returned samples are always
+ * contiguous, read stops early if samples were lost.
+ * lms_stream_meta_t::waitForTimestamp is not supported.
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param reader        reader index returned by LMS_AttachStreamReader().
+ * @param samples       array of sample buffers, one per stream channel.
+ * @param sample_count  Number of samples to read to each buffer
+ * @param meta          Metadata. See the ::lms_stream_meta_t description.
+ * @param timeout_ms    how long to wait for data before timing out.
+ *
+ * @return number of samples received to each buffer on success, (-1) on
+ * failure or when reader was dropped for lagging behind
+ */
+API_EXPORT int CALL_CONV LMS_RecvStreamReader(lms_stream_t *stream, int reader,
+             void **samples, size_t sample_count, lms_stream_meta_t *meta,
+             unsigned timeout_ms);
+
+/**
+ * Get status of reader attached with LMS_AttachStreamReader().
+ * lms_stream_status_t::fifoFilledCount holds samples waiting to be read by
+ * reader, lms_stream_status_t::overrun number of packets lost by reader and
+ * lms_stream_status_t::active is false if reader was dropped.
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param reader    reader index returned by LMS_AttachStreamReader().
+ * @param status    Stream status. See the ::lms_stream_status_t for description
+ *
+ * @return 0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetStreamReaderStatus(lms_stream_t *stream, int reader,
+             lms_stream_status_t* status);
+
+/**
+ * Get direct access to received samples without copying them out of the
+ * stream FIFO. Returned buffer holds up to one FIFO packet of samples in
+ * 16-bit integer complex format (12-bit range when stream uses
+ * ::LMS_FMT_I12), regardless of lms_stream_t::dataFmt.
+ * Buffer stays valid until it is returned with LMS_RecvStreamRelease().
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param[out] samples  pointer to samples inside stream FIFO.
+ * @param[out] handle   buffer handle to be passed to LMS_RecvStreamRelease().
+ * @param meta          Metadata. See the ::lms_stream_meta_t description.
+ * @param timeout_ms    how long to wait for data before timing out.
+ *
+ * @return number of samples in buffer on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_RecvStreamAcquire(lms_stream_t *stream,
+             const int16_t **samples, int *handle, lms_stream_meta_t *meta,
+             unsigned timeout_ms);
+
+/**
+ * Return buffer obtained with LMS_RecvStreamAcquire() to the stream FIFO.
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param handle    buffer handle returned by LMS_RecvStreamAcquire().
+ *
+ * @return 0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_RecvStreamRelease(lms_stream_t *stream, int handle);
+
 /**
  * Get stream operation status
  *
@@ -1191,6 +1440,112 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream,
                             const void *samples,size_t sample_count,
                             const lms_stream_meta_t *meta, unsigned timeout_ms);
 
+/**
+ * Write samples of all channels of joint stream (::LMS_STREAM_JOINT) in one call.
+ * Can also be used with single channel streams, passing one buffer.
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param samples       array of sample buffers, one per stream channel.
+ * @param sample_count  Number of samples to write from each buffer
+ * @param meta          Metadata. See the ::lms_stream_meta_t description.
+ * @param timeout_ms    how long to wait for free space before timing out.
+ *
+ * @return number of samples sent from each buffer on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SendStreamMulti(lms_stream_t *stream, const void **samples,
+             size_t sample_count, const lms_stream_meta_t *meta, unsigned timeout_ms);
+
+/**
+ * Get direct access to the stream FIFO storage, so that samples can be
+ * written in place without copying them. Samples must be written in 16-bit
+ * integer complex format (12-bit range when stream uses ::LMS_FMT_I12),
+ * regardless of lms_stream_t::dataFmt.
+ * Written samples are submitted with LMS_SendStreamCommit().
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param[out] samples  pointer to free storage inside stream FIFO.
+ * @param[out] handle   buffer handle to be passed to LMS_SendStreamCommit().
+ * @param timeout_ms    how long to wait for free space before timing out.
+ *
+ * @return number of samples that can be written on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SendStreamAcquire(lms_stream_t *stream,
+             int16_t **samples, int *handle, unsigned timeout_ms);
+
+/**
+ * Submit samples written to buffer obtained with LMS_SendStreamAcquire().
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param handle        buffer handle returned by LMS_SendStreamAcquire().
+ * @param sample_count  Number of samples written to buffer
+ * @param meta          Metadata. See the ::lms_stream_meta_t description.
+ *
+ * @return number of samples submitted on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SendStreamCommit(lms_stream_t *stream, int handle,
+             size_t sample_count, const lms_stream_meta_t *meta);
+
+/**
+ * Get next Tx burst event. Bursts are checked against the latest Rx timestamp
+ * when they are taken from stream FIFO, so Rx stream has to be running for
+ * late burst detection. Bursts ending with lms_stream_meta_t::flushPartialPacket
+ * are acknowledged. Events are discarded if they are not read in time.
+ *
+ * @param stream        Tx stream previously initialized with LMS_SetupStream().
+ * @param[out] event    burst event
+ * @param timeout_ms    how long to wait for event before timing out.
+ *
+ * @return 1 if event was returned, 0 on timeout, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetTxBurstEvent(lms_stream_t *stream,
+             lms_burst_event_t *event, unsigned timeout_ms);
+
+/**
+ * Get event file descriptor of stream created with ::LMS_STREAM_EVENT_FD flag,
+ * for use with poll(), epoll or io_uring. Descriptor becomes readable when at
+ * least lms_stream_t::eventThreshold samples can be received (Rx) or sent (Tx),
+ * on Rx FIFO overflow or packet loss and on Tx burst events.
+ * Reading 8 bytes from descriptor clears the event. Descriptor is owned by
+ * stream and closed by LMS_DestroyStream(). Supported only on Linux.
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ *
+ * @return file descriptor on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetStreamFd(lms_stream_t *stream);
+
+/**
+ * Get next range of Rx samples that were lost, either dropped by FIFO
+ * overflow policy (see lms_stream_t::overflowPolicy) or lost on link.
+ * When gap records are not read in time, following gaps are merged into one
+ * range covering all of them.
+ *
+ * @param stream        Rx stream previously initialized with LMS_SetupStream().
+ * @param[out] gap      lost samples range
+ * @param timeout_ms    how long to wait for gap record before timing out.
+ *
+ * @return 1 if gap was returned, 0 on timeout, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetStreamGap(lms_stream_t *stream,
+             lms_stream_gap_t *gap, unsigned timeout_ms);
+
+/**
+ * Set callback consuming received samples instead of LMS_RecvStream().
+ * Callback is called from stream worker thread right after received packets
+ * are parsed, with packets still in stream FIFO, so samples are not copied.
+ * Callback should return quickly, FIFO packets are not reused until it returns.
+ * Can be set only while stream is stopped.
+ *
+ * @param stream    Rx stream previously initialized with LMS_SetupStream(),
+ *                  must stay valid while callback is set.
+ * @param callback  callback function, NULL to receive with LMS_RecvStream() again
+ * @param userData  pointer passed to callback
+ *
+ * @return 0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamCallback(lms_stream_t *stream,
+             lms_stream_cb_t callback, void *userData);
+
 /**
  * Uploads waveform to on board memory for later use
  * @param device        Device handle previously obtained by LMS_Open().
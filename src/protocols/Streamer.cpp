@@ -1,5 +1,6 @@
 #include <assert.h>
 #include "FPGA_common.h"
+#include "PacketCodec.h"
 #include "LMS7002M.h"
 #include <ciso646>
 #include "Logger.h"
@@ -7,23 +8,82 @@
 #include "IConnection.h"
 #include <complex>
 #include "LMSBoards.h"
+#include <string.h>
+#include <cstdlib>
+#include <limits>
+#ifdef __unix__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 namespace lime
 {
 
+//! Returns value of unsigned integer environment variable, 0 if it is not set
+static unsigned GetEnvUnsigned(const char* name)
+{
+    const char* value = std::getenv(name);
+    return value ? std::strtoul(value, nullptr, 0) : 0;
+}
+
+//! Largest number of packets in one link transfer (1 MiB)
+static const unsigned maxTransferPackets = 256;
+
+//! Returns number of bits in I or Q value of link format
+static int LinkSampleBits(StreamConfig::StreamDataFormat linkFormat)
+{
+    if (linkFormat == StreamConfig::FMT_INT8)
+        return 8;
+    return linkFormat == StreamConfig::FMT_INT12 ? 12 : 16;
+}
+
+//! Returns largest I or Q value of link format
+static int16_t LinkSampleLimit(StreamConfig::StreamDataFormat linkFormat)
+{
+    return (1 << (LinkSampleBits(linkFormat)-1)) - 1;
+}
+
+//! Returns number of samples per channel in FPGA packet payload
+static int LinkSamplesInPacket(StreamConfig::StreamDataFormat linkFormat, int chCount)
+{
+    return sizeof(FPGA_DataPacket::data)*8/(2*LinkSampleBits(linkFormat))/chCount;
+}
+
 StreamChannel::StreamChannel(Streamer* streamer) :
     mStreamer(streamer),
     pktLost(0),
+    clippedSamples(0),
+    lateBursts(0),
+    burstLead(0),
     mActive(false),
     used(false),
-    fifo(nullptr)
+    fifo(nullptr),
+    burstEvents(nullptr),
+    gaps(nullptr),
+    eventFd(-1),
+    eventThreshold(0)
 {
+    for (auto& reader : readers)
+        reader = nullptr;
 }
 
 StreamChannel::~StreamChannel()
 {
+    DetachReaders();
     if (fifo)
         delete fifo;
+    if (burstEvents)
+        delete burstEvents;
+    if (gaps)
+        delete gaps;
+#ifdef __unix__
+    if (eventFd >= 0)
+        close(eventFd);
+#endif
 }
 
 void StreamChannel::Setup(StreamConfig conf)
@@ -31,68 +91,408 @@ void StreamChannel::Setup(StreamConfig conf)
     used = true;
     config = conf;
     pktLost = 0;
+    clippedSamples = 0;
+    lateBursts = 0;
+    if (config.isTx && !burstEvents)
+        burstEvents = new SPSCQueue<BurstEvent>(256);
+    if (!config.isTx && !gaps)
+        gaps = new SPSCQueue<Gap>(256);
+    pendingGap.samplesCount = 0;
     int bufferLength = config.bufferLength == 0 ? 1024*4*1024 : config.bufferLength;
     int pktSize = config.format != StreamConfig::FMT_INT12 ? samples16InPkt : samples12InPkt;
+    if (config.linkFormat == StreamConfig::FMT_INT8)
+        pktSize = samples8InPkt;
     if (bufferLength < 4*pktSize)  //set FIFO to at least 4 packets
         bufferLength = 4*pktSize;
     if (!fifo)
         fifo = new RingFIFO();
-    fifo->Resize(pktSize, bufferLength/pktSize);
+    const uint32_t memFlags = (config.hugePages ? RingFIFO::MEM_HUGE_PAGES : 0) | (config.lockMemory ? RingFIFO::MEM_LOCK : 0);
+    const uint32_t applied = fifo->Resize(pktSize, bufferLength/pktSize, memFlags, GetChannelCount());
+    if ((memFlags & RingFIFO::MEM_HUGE_PAGES) && !(applied & RingFIFO::MEM_HUGE_PAGES))
+        lime::warning("Stream FIFO: huge pages are not available, using regular pages");
+    if ((memFlags & RingFIFO::MEM_LOCK) && !(applied & RingFIFO::MEM_LOCK))
+        lime::warning("Stream FIFO: failed to lock memory, check RLIMIT_MEMLOCK");
+    if (!config.isTx)
+    {
+        RingFIFO::OverflowPolicy policy = RingFIFO::DROP_OLDEST;
+        if (config.overflowPolicy == StreamConfig::OVERFLOW_DROP_NEWEST)
+            policy = RingFIFO::DROP_NEWEST;
+        else if (config.overflowPolicy == StreamConfig::OVERFLOW_BLOCK)
+            policy = RingFIFO::BLOCK;
+        fifo->SetOverflowPolicy(policy, config.overflowBlockTime);
+        RingFIFO::GapMode gapMode = RingFIFO::GAP_CONCATENATE;
+        if (config.gapHandling == StreamConfig::GAP_ZERO_FILL)
+            gapMode = RingFIFO::GAP_ZERO_FILL;
+        else if (config.gapHandling == StreamConfig::GAP_SPLIT)
+            gapMode = RingFIFO::GAP_SPLIT;
+        fifo->SetGapMode(gapMode);
+    }
+
+    const uint32_t fifoSize = fifo->GetInfo(false).size;
+    eventThreshold = config.eventThreshold < fifoSize ? config.eventThreshold : fifoSize;
+    if (eventThreshold > 0 && eventFd < 0)
+    {
+#ifdef __linux__
+        eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (eventFd < 0)
+            lime::warning("Stream: failed to create event descriptor: %s", strerror(errno));
+#else
+        lime::warning("Stream event descriptor is not supported on this platform");
+#endif
+    }
 }
 
 void StreamChannel::Close()
 {
     if (mActive)
         Stop();
+    DetachReaders();
     if (fifo)
         delete fifo;
     fifo = nullptr;
+    if (burstEvents)
+        delete burstEvents;
+    burstEvents = nullptr;
+    if (gaps)
+        delete gaps;
+    gaps = nullptr;
+#ifdef __unix__
+    if (eventFd >= 0)
+        close(eventFd);
+#endif
+    eventFd = -1;
+    if (config.jointChannels) //release second channel of the pair
+        (config.isTx ? mStreamer->mTxStreams : mStreamer->mRxStreams)[1].used = false;
+    config.jointChannels = false;
     used = false;
 }
 
+//! Returns number of channels transferred by stream, 2 for joint streams
+int StreamChannel::GetChannelCount() const
+{
+    return config.jointChannels ? 2 : 1;
+}
+
 int StreamChannel::Write(const void* samples, const uint32_t count, const Metadata *meta, const int32_t timeout_ms)
+{
+    if (config.jointChannels)
+        return ReportError(EINVAL, "Joint stream requires WriteMulti()");
+    return WriteMulti(&samples, count, meta, timeout_ms);
+}
+
+/** @brief Writes samples of all stream channels to Tx FIFO
+    @param samples source buffers in stream data format, one per channel (GetChannelCount())
+    @param count number of samples to write from each buffer
+    @param meta timestamp and flags of samples
+    @param timeout_ms timeout duration for operation
+    @return number of samples written from each buffer
+*/
+int StreamChannel::WriteMulti(const void* const* samples, const uint32_t count, const Metadata *meta, const int32_t timeout_ms)
 {
     int pushed = 0;
+    const int chCount = GetChannelCount();
+    const int stride = fifo->GetChannelStride();
+    //fullScale is given for 16 bit samples, narrower link formats are scaled to their range
+    const int16_t limit = LinkSampleLimit(mStreamer->dataLinkFormat);
+    const float linkScale = config.fullScale * (limit / 32767.0f);
     if(config.format == StreamConfig::FMT_FLOAT32 && config.isTx)
     {
-        const float* samplesFloat = (const float*)samples;
-        int16_t* samplesShort = new int16_t[2*count];
-        for(size_t i=0; i<2*count; ++i)
-            samplesShort[i] = samplesFloat[i]*32767.0f;
-        const complex16_t* ptr = (const complex16_t*)samplesShort ;
-        pushed = fifo->push_samples(ptr, count, meta->timestamp, timeout_ms, meta->flags);
-        delete[] samplesShort;
+        //convert while copying into FIFO
+        const float* const* samplesFloat = (const float* const*)samples;
+        const float scale = linkScale;
+        const PacketCodec& codec = GetPacketCodec();
+        unsigned clipped = 0;
+        pushed = fifo->push_converted([samplesFloat, chCount, stride, scale, limit, &codec, &clipped](complex16_t* dest, uint32_t offset, int cnt){
+            for (int ch = 0; ch < chCount; ++ch)
+                clipped += FloatToSamples(codec, &samplesFloat[ch][2*offset], cnt, dest + ch*stride, scale, limit);
+            }, count, meta->timestamp, timeout_ms, meta->flags);
+        clippedSamples += clipped;
+    }
+    else if(config.format == StreamConfig::FMT_FLOAT32_PLANAR)
+    {
+        const float* const* samplesFloat = (const float* const*)samples;
+        const float scale = linkScale;
+        const PacketCodec& codec = GetPacketCodec();
+        unsigned clipped = 0;
+        pushed = fifo->push_converted([samplesFloat, count, chCount, stride, scale, limit, &codec, &clipped](complex16_t* dest, uint32_t offset, int cnt){
+            for (int ch = 0; ch < chCount; ++ch)
+                clipped += FloatPlanarToSamples(codec, &samplesFloat[ch][offset], &samplesFloat[ch][count+offset], cnt, dest + ch*stride, scale, limit);
+            }, count, meta->timestamp, timeout_ms, meta->flags);
+        clippedSamples += clipped;
+    }
+    else if(config.format == StreamConfig::FMT_INT16_PLANAR)
+    {
+        const int16_t* const* ptr = (const int16_t* const*)samples;
+        const PacketCodec& codec = GetPacketCodec();
+        pushed = fifo->push_converted([ptr, count, chCount, stride, &codec](complex16_t* dest, uint32_t offset, int cnt){
+            for (int ch = 0; ch < chCount; ++ch)
+                PlanarToSamples(codec, &ptr[ch][offset], &ptr[ch][count+offset], cnt, dest + ch*stride);
+            }, count, meta->timestamp, timeout_ms, meta->flags);
+    }
+    else if(config.format == StreamConfig::FMT_INT8)
+    {
+        const int8_t* const* ptr = (const int8_t* const*)samples;
+        const int shift = LinkSampleBits(mStreamer->dataLinkFormat) - 8;
+        const PacketCodec& codec = GetPacketCodec();
+        pushed = fifo->push_converted([ptr, chCount, stride, shift, &codec](complex16_t* dest, uint32_t offset, int cnt){
+            for (int ch = 0; ch < chCount; ++ch)
+                Int8ToSamples(codec, &ptr[ch][2*offset], cnt, dest + ch*stride, shift);
+            }, count, meta->timestamp, timeout_ms, meta->flags);
     }
     else
     {
-        const complex16_t* ptr = (const complex16_t*)samples;
-        pushed = fifo->push_samples(ptr, count, meta->timestamp, timeout_ms, meta->flags);
+        const complex16_t* const* ptr = (const complex16_t* const*)samples;
+        pushed = fifo->push_converted([ptr, chCount, stride](complex16_t* dest, uint32_t offset, int cnt){
+            for (int ch = 0; ch < chCount; ++ch)
+                memcpy(dest + ch*stride, &ptr[ch][offset], cnt*sizeof(complex16_t));
+            }, count, meta->timestamp, timeout_ms, meta->flags);
     }
     return pushed;
 }
 
+/** @brief Reads samples from Rx FIFO
+    If meta->flags has RingFIFO::SYNC_TIMESTAMP set, samples older than meta->timestamp
+    are dropped inside FIFO without copying, so that read starts at requested timestamp,
+    or at the first later one if requested samples are no longer available.
+    @param samples destination buffer in stream data format
+    @param count number of samples to read
+    @param meta requested start, returns timestamp of the first sample in buffer
+    @param timeout_ms timeout duration for operation
+    @return number of samples read
+*/
 int StreamChannel::Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms)
+{
+    if (config.jointChannels)
+        return ReportError(EINVAL, "Joint stream requires ReadMulti()");
+    return ReadMulti(&samples, count, meta, timeout_ms);
+}
+
+/** @brief Reads samples of all stream channels from Rx FIFO
+    All buffers receive the same number of samples starting at the same timestamp.
+    Requested start timestamp is handled the same way as in Read().
+    @param samples destination buffers in stream data format, one per channel (GetChannelCount())
+    @param count number of samples to read to each buffer
+    @param meta requested start, returns timestamp of the first sample in buffers
+    @param timeout_ms timeout duration for operation
+    @return number of samples read to each buffer
+*/
+int StreamChannel::ReadMulti(void* const* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms)
+{
+    if ((meta->flags & RingFIFO::SYNC_TIMESTAMP) && !fifo->skip_to_timestamp(meta->timestamp, timeout_ms))
+        return 0;
+    bool discontinuity = false;
+    const int popped = PopConverted(*fifo, samples, count, &meta->timestamp, timeout_ms, &discontinuity);
+    meta->flags |= RingFIFO::SYNC_TIMESTAMP;
+    if (discontinuity)
+        meta->flags |= RingFIFO::DISCONTINUITY;
+    else
+        meta->flags &= ~RingFIFO::DISCONTINUITY;
+    return popped;
+}
+
+/** @brief Copies samples out of FIFO or FIFO reader converting them to stream data format
+    @param source RingFIFO or RingFIFO::Reader to take samples from
+    @param samples destination buffers, one per channel
+    @param count number of samples to read to each buffer
+    @param timestamp returns timestamp of the first sample in buffers
+    @param timeout_ms timeout duration for operation
+    @param discontinuity returns true if samples do not follow previously read samples
+    @return number of samples read to each buffer
+*/
+template<class Source>
+int StreamChannel::PopConverted(Source& source, void* const* samples, const uint32_t count, uint64_t* timestamp, const int32_t timeout_ms, bool* discontinuity)
 {
     int popped = 0;
+    const int chCount = GetChannelCount();
+    const int stride = fifo->GetChannelStride();
+    const float linkScale = config.fullScale * (LinkSampleLimit(mStreamer->dataLinkFormat) / 32767.0f);
     if(config.format == StreamConfig::FMT_FLOAT32 && !config.isTx)
     {
-        //in place conversion
-        complex16_t* ptr = (complex16_t*)samples;
-        int16_t* samplesShort = (int16_t*)samples;
-        float* samplesFloat = (float*)samples;
-        popped = fifo->pop_samples(ptr, count, &meta->timestamp, timeout_ms);
-        for(int i=2*popped-1; i>=0; --i)
-            samplesFloat[i] = (float)samplesShort[i]/32767.0f;
+        //convert while copying out of FIFO
+        float* const* samplesFloat = (float* const*)samples;
+        const float scale = 1.0f/linkScale;
+        const PacketCodec& codec = GetPacketCodec();
+        popped = source.pop_converted([samplesFloat, chCount, stride, scale, &codec](uint32_t offset, const complex16_t* src, int cnt){
+            for (int ch = 0; ch < chCount; ++ch)
+                SamplesToFloat(codec, src + ch*stride, cnt, &samplesFloat[ch][2*offset], scale);
+            }, count, timestamp, timeout_ms, discontinuity);
+    }
+    else if(config.format == StreamConfig::FMT_FLOAT32_PLANAR)
+    {
+        float* const* samplesFloat = (float* const*)samples;
+        const float scale = 1.0f/linkScale;
+        const PacketCodec& codec = GetPacketCodec();
+        popped = source.pop_converted([samplesFloat, count, chCount, stride, scale, &codec](uint32_t offset, const complex16_t* src, int cnt){
+            for (int ch = 0; ch < chCount; ++ch)
+                SamplesToFloatPlanar(codec, src + ch*stride, cnt, &samplesFloat[ch][offset], &samplesFloat[ch][count+offset], scale);
+            }, count, timestamp, timeout_ms, discontinuity);
+    }
+    else if(config.format == StreamConfig::FMT_INT16_PLANAR)
+    {
+        int16_t* const* ptr = (int16_t* const*)samples;
+        const PacketCodec& codec = GetPacketCodec();
+        popped = source.pop_converted([ptr, count, chCount, stride, &codec](uint32_t offset, const complex16_t* src, int cnt){
+            for (int ch = 0; ch < chCount; ++ch)
+                SamplesToPlanar(codec, src + ch*stride, cnt, &ptr[ch][offset], &ptr[ch][count+offset]);
+            }, count, timestamp, timeout_ms, discontinuity);
+    }
+    else if(config.format == StreamConfig::FMT_INT8)
+    {
+        int8_t* const* ptr = (int8_t* const*)samples;
+        const int shift = LinkSampleBits(mStreamer->dataLinkFormat) - 8;
+        const PacketCodec& codec = GetPacketCodec();
+        popped = source.pop_converted([ptr, chCount, stride, shift, &codec](uint32_t offset, const complex16_t* src, int cnt){
+            for (int ch = 0; ch < chCount; ++ch)
+                SamplesToInt8(codec, src + ch*stride, cnt, &ptr[ch][2*offset], shift);
+            }, count, timestamp, timeout_ms, discontinuity);
     }
     else
     {
-        complex16_t* ptr = (complex16_t*)samples;
-        popped = fifo->pop_samples(ptr, count, &meta->timestamp, timeout_ms);
+        complex16_t* const* ptr = (complex16_t* const*)samples;
+        popped = source.pop_converted([ptr, chCount, stride](uint32_t offset, const complex16_t* src, int cnt){
+            for (int ch = 0; ch < chCount; ++ch)
+                memcpy(&ptr[ch][offset], src + ch*stride, cnt*sizeof(complex16_t));
+            }, count, timestamp, timeout_ms, discontinuity);
+    }
+    return popped;
+}
+
+/** @brief Attaches additional reader to Rx channel, which reads the same samples
+    as Read()/ReadMulti() independently of them, starting with the next received packet.
+    Readers never stall the receive thread, a reader that falls behind by more than
+    FIFO size loses samples, or is dropped when dropWhenLagging is set.
+    @param dropWhenLagging stop reader when it falls behind, instead of skipping lost samples
+    @return reader handle, -1 on failure
+*/
+int StreamChannel::AttachReader(bool dropWhenLagging)
+{
+    if (config.isTx)
+        return ReportError(EINVAL, "Readers can be attached only to Rx streams");
+    for (int i = 0; i < maxReaders; ++i)
+        if (readers[i] == nullptr)
+        {
+            readers[i] = new RingFIFO::Reader(fifo, dropWhenLagging ? RingFIFO::Reader::LAG_DETACH : RingFIFO::Reader::LAG_SKIP);
+            return i;
+        }
+    return ReportError(ENOMEM, "Stream already has %d readers attached", maxReaders);
+}
+
+//! Removes reader attached with AttachReader(), it must not be in use
+int StreamChannel::DetachReader(const int reader)
+{
+    if (reader < 0 || reader >= maxReaders || readers[reader] == nullptr)
+        return ReportError(EINVAL, "Invalid stream reader");
+    delete readers[reader];
+    readers[reader] = nullptr;
+    return 0;
+}
+
+void StreamChannel::DetachReaders()
+{
+    for (auto& reader : readers)
+    {
+        delete reader;
+        reader = nullptr;
     }
+}
+
+/** @brief Reads samples through reader attached with AttachReader()
+    Each reader must be used from one thread. Read stops early when samples
+    were lost, so that returned samples are always contiguous.
+    @param reader reader handle
+    @param samples destination buffers in stream data format, one per channel (GetChannelCount())
+    @param count number of samples to read to each buffer
+    @param meta returns timestamp of the first sample in buffers
+    @param timeout_ms timeout duration for operation
+    @return number of samples read to each buffer, -1 if reader was dropped for lagging behind
+*/
+int StreamChannel::ReadMultiFrom(const int reader, void* const* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms)
+{
+    if (reader < 0 || reader >= maxReaders || readers[reader] == nullptr)
+        return ReportError(EINVAL, "Invalid stream reader");
+    if (readers[reader]->IsDetached())
+        return ReportError(EPIPE, "Stream reader was dropped for lagging behind");
+    bool discontinuity = false;
+    const int popped = PopConverted(*readers[reader], samples, count, &meta->timestamp, timeout_ms, &discontinuity);
     meta->flags |= RingFIFO::SYNC_TIMESTAMP;
+    if (discontinuity)
+        meta->flags |= RingFIFO::DISCONTINUITY;
+    else
+        meta->flags &= ~RingFIFO::DISCONTINUITY;
     return popped;
 }
 
+/** @brief Returns statistics of reader attached with AttachReader()
+    Lag peak, overflow and underflow counters are reset after reading them.
+*/
+int StreamChannel::GetReaderInfo(const int reader, ReaderInfo* info)
+{
+    if (reader < 0 || reader >= maxReaders || readers[reader] == nullptr)
+        return ReportError(EINVAL, "Invalid stream reader");
+    *info = readers[reader]->GetInfo();
+    return 0;
+}
+
+/** @brief Gives direct access to samples stored in FIFO without copying them
+    Samples are always complex16_t in stream link format, regardless of the stream data format.
+    Buffer must be returned with ReleaseReadBuffer() when no longer needed.
+    @param samples returns pointer to samples
+    @param meta returns timestamp of the first sample
+    @param handle returns buffer handle for ReleaseReadBuffer()
+    @param timeout_ms timeout duration for operation
+    @return number of samples available in buffer, 0 on timeout
+*/
+int StreamChannel::AcquireReadBuffer(const complex16_t** samples, Metadata* meta, int* handle, const int32_t timeout_ms)
+{
+    if (config.jointChannels)
+        return ReportError(EINVAL, "Direct buffer access is not supported for joint streams");
+    uint32_t count = 0;
+    *handle = fifo->acquire_packet(samples, &count, &meta->timestamp, timeout_ms);
+    if (*handle < 0)
+        return 0;
+    meta->flags |= RingFIFO::SYNC_TIMESTAMP;
+    return count;
+}
+
+int StreamChannel::ReleaseReadBuffer(const int handle)
+{
+    if (fifo->release_packet(handle) != 0)
+        return ReportError(EINVAL, "Invalid stream buffer handle");
+    return 0;
+}
+
+/** @brief Gives direct access to FIFO storage for writing samples without copying them
+    Samples must be written as complex16_t in stream link format, regardless of the stream data format.
+    @param samples returns pointer to free samples storage
+    @param handle returns buffer handle for CommitWriteBuffer()
+    @param timeout_ms timeout duration for operation
+    @return number of samples that can be written to buffer, 0 on timeout
+*/
+int StreamChannel::AcquireWriteBuffer(complex16_t** samples, int* handle, const int32_t timeout_ms)
+{
+    if (config.jointChannels)
+        return ReportError(EINVAL, "Direct buffer access is not supported for joint streams");
+    uint32_t count = 0;
+    *handle = fifo->acquire_free_packet(samples, &count, timeout_ms);
+    if (*handle < 0)
+        return 0;
+    return count;
+}
+
+/** @brief Submits samples written to buffer obtained with AcquireWriteBuffer()
+    @param handle buffer handle returned by AcquireWriteBuffer()
+    @param count number of samples written to buffer
+    @param meta timestamp and flags of written samples
+    @return number of samples submitted, -1 on failure
+*/
+int StreamChannel::CommitWriteBuffer(const int handle, const uint32_t count, const Metadata* meta)
+{
+    int committed = fifo->commit_packet(handle, count, meta->timestamp, meta->flags);
+    if (committed < 0)
+        return ReportError(EINVAL, "Invalid stream buffer handle");
+    return committed;
+}
+
 StreamChannel::Info StreamChannel::GetInfo()
 {
     Info stats;
@@ -104,7 +504,12 @@ StreamChannel::Info StreamChannel::GetInfo()
     stats.droppedPackets = pktLost;
     stats.overrun = info.overflow;
     stats.underrun = info.underflow;
+    stats.clippedSamples = clippedSamples;
+    stats.lateBursts = lateBursts;
+    stats.gapsCount = gaps ? gaps->size() : 0;
     pktLost = 0;
+    clippedSamples = 0;
+    lateBursts = 0;
     if(config.isTx)
     {
         stats.timestamp = mStreamer->txLastTimestamp.load(std::memory_order_relaxed);
@@ -114,10 +519,176 @@ StreamChannel::Info StreamChannel::GetInfo()
     {
         stats.timestamp = mStreamer->rxLastTimestamp.load(std::memory_order_relaxed);
         stats.linkRate = mStreamer->rxDataRate_Bps.load(std::memory_order_relaxed);
+        stats.linkQueueFill = mStreamer->rxLinkQueueFill.load(std::memory_order_relaxed);
+        stats.linkQueueSize = mStreamer->rxLinkQueueSize.load(std::memory_order_relaxed);
+        stats.parseQueueFill = mStreamer->rxParseQueueFill.load(std::memory_order_relaxed);
+        stats.parseQueuePeak = mStreamer->rxParseQueuePeak.exchange(0, std::memory_order_relaxed);
+        stats.parseQueueSize = mStreamer->rxParseQueueSize.load(std::memory_order_relaxed);
     }
     return stats;
 }
 
+/** @brief Returns next Tx burst event reported by stream thread
+    Events that are not read are discarded when event queue is full.
+    @param event returns burst event
+    @param timeout_ms how long to wait for event
+    @return 1 if event was returned, 0 on timeout, -1 if channel is not Tx
+*/
+int StreamChannel::ReadBurstEvent(BurstEvent* event, const int32_t timeout_ms)
+{
+    if (!burstEvents)
+        return -1;
+    return burstEvents->pop(*event, timeout_ms) ? 1 : 0;
+}
+
+/** @brief Publishes Tx burst event, called from stream thread
+*/
+void StreamChannel::ReportBurst(BurstEvent::Type type, uint64_t timestamp, uint64_t time, bool dropped)
+{
+    if (type == BurstEvent::BURST_LATE)
+        lateBursts++;
+    if (!burstEvents)
+        return;
+    BurstEvent event;
+    event.type = type;
+    event.timestamp = timestamp;
+    event.time = time;
+    event.dropped = dropped;
+    burstEvents->push(event);
+    NotifyEvent(true);
+}
+
+/** @brief Returns event file descriptor, enabled with StreamConfig::eventThreshold
+    Descriptor becomes readable when at least eventThreshold samples can be read (Rx)
+    or written (Tx), on Rx overflow or packet loss and on Tx burst events.
+    Reading it clears the event, it stays valid until stream is closed.
+    @return file descriptor, -1 if not available
+*/
+int StreamChannel::GetEventFd() const
+{
+    if (eventFd < 0)
+        return ReportError(EINVAL, "Stream event descriptor is not enabled");
+    return eventFd;
+}
+
+/** @brief Signals event descriptor, called from stream thread
+    @param force signal regardless of FIFO fill, for overflows and burst events
+*/
+void StreamChannel::NotifyEvent(bool force)
+{
+#ifdef __unix__
+    if (eventFd < 0)
+        return;
+    if (!force)
+    {
+        const RingFIFO::BufferInfo info = fifo->GetInfo(false);
+        const uint32_t available = config.isTx ? info.size - info.itemsFilled : info.itemsFilled;
+        if (available < eventThreshold)
+            return;
+    }
+    const uint64_t value = 1;
+    //fails only if counter would overflow, descriptor is readable then anyway
+    const ssize_t ret = write(eventFd, &value, sizeof(value));
+    (void)ret;
+#endif
+}
+
+/** @brief Sets function consuming received packets instead of Read()
+    Callback is called from stream thread right after packets are parsed, with
+    packets still in FIFO, so it should return quickly to avoid packet loss.
+    Can be changed only while stream is not active.
+    @param cb callback, empty to consume packets with Read() again
+    @return 0 on success, -1 on failure
+*/
+int StreamChannel::SetCallback(Callback cb)
+{
+    if (config.isTx)
+        return ReportError(EINVAL, "Callback can be set only for Rx streams");
+    if (mActive)
+        return ReportError(EBUSY, "Callback can not be changed while stream is active");
+    callback = cb;
+    return 0;
+}
+
+//! Hands packets waiting in FIFO to callback, called from stream thread
+void StreamChannel::RunCallback()
+{
+    const int maxBatch = 64;
+    const SamplesPacket* packets[maxBatch];
+    int handles[maxBatch];
+    const complex16_t* samples[maxBatch];
+    uint32_t samplesCount[maxBatch];
+    uint64_t timestamps[maxBatch];
+    PacketBatch batch;
+    batch.samples = samples;
+    batch.samplesCount = samplesCount;
+    batch.timestamps = timestamps;
+    batch.channelStride = fifo->GetChannelStride();
+    while ((batch.packetsCount = fifo->acquire_packets(packets, handles, maxBatch)) > 0)
+    {
+        for (int i = 0; i < batch.packetsCount; ++i)
+        {
+            samples[i] = packets[i]->samples;
+            samplesCount[i] = packets[i]->last;
+            timestamps[i] = packets[i]->timestamp;
+        }
+        callback(batch);
+        for (int i = 0; i < batch.packetsCount; ++i)
+            fifo->release_packet(handles[i]);
+    }
+}
+
+/** @brief Returns next range of Rx samples that were lost
+    Gaps are recorded for samples dropped by FIFO overflow policy and for packets lost on link.
+    If gap queue is full, following gaps are merged into one range covering all of them,
+    its samplesCount saturates at UINT32_MAX.
+    @param gap returns lost samples range
+    @param timeout_ms how long to wait for gap record
+    @return 1 if gap was returned, 0 on timeout, -1 if channel is not Rx
+*/
+int StreamChannel::ReadGap(Gap* gap, const int32_t timeout_ms)
+{
+    if (!gaps)
+        return -1;
+    return gaps->pop(*gap, timeout_ms) ? 1 : 0;
+}
+
+/** @brief Records lost Rx samples, called from stream thread
+    Contiguous ranges with the same cause are merged until FlushGap() is called.
+*/
+void StreamChannel::ReportGap(uint64_t timestamp, uint32_t samplesCount, Gap::Cause cause)
+{
+    const uint64_t maxCount = std::numeric_limits<uint32_t>::max();
+    const bool contiguous = pendingGap.timestamp + pendingGap.samplesCount == timestamp && pendingGap.cause == cause;
+    if (pendingGap.samplesCount > 0 && (!contiguous || pendingGap.samplesCount + uint64_t(samplesCount) > maxCount))
+    {
+        FlushGap();
+        if (pendingGap.samplesCount > 0) //queue is full, extend pending gap over both ranges
+        {
+            const uint64_t end = std::max(pendingGap.timestamp + pendingGap.samplesCount, timestamp + samplesCount);
+            pendingGap.timestamp = std::min(pendingGap.timestamp, timestamp);
+            pendingGap.samplesCount = std::min(end - pendingGap.timestamp, maxCount);
+            return;
+        }
+    }
+    if (pendingGap.samplesCount == 0)
+    {
+        pendingGap.timestamp = timestamp;
+        pendingGap.cause = cause;
+    }
+    pendingGap.samplesCount += samplesCount;
+}
+
+//! Queues gap recorded by ReportGap(), called from stream thread
+void StreamChannel::FlushGap()
+{
+    if (pendingGap.samplesCount > 0 && gaps && gaps->push(pendingGap))
+    {
+        pendingGap.samplesCount = 0;
+        NotifyEvent(true);
+    }
+}
+
 int StreamChannel::GetStreamSize()
 {
     return mStreamer->GetStreamSize(config.isTx);
@@ -130,9 +701,13 @@ bool StreamChannel::IsActive() const
 
 int StreamChannel::Start()
 {
-    mActive = true;
+    //FIFO is cleared before producer/consumer threads can see channel as active
     fifo->Clear();
     pktLost = 0;
+    pendingGap.samplesCount = 0;
+    if (config.isTx)
+        NotifyEvent(); //empty FIFO can be written
+    mActive = true;
     return mStreamer->UpdateThreads();
 }
 
@@ -154,8 +729,17 @@ Streamer::Streamer(FPGA* f, LMS7002M* chip, int id) : mRxStreams(2, this), mTxSt
     terminateTx.store(false, std::memory_order_relaxed);
     rxDataRate_Bps.store(0, std::memory_order_relaxed);
     txDataRate_Bps.store(0, std::memory_order_relaxed);
+    rxLinkQueueFill.store(0, std::memory_order_relaxed);
+    rxLinkQueueSize.store(0, std::memory_order_relaxed);
+    rxParseQueueFill.store(0, std::memory_order_relaxed);
+    rxParseQueuePeak.store(0, std::memory_order_relaxed);
+    rxParseQueueSize.store(0, std::memory_order_relaxed);
+    rxPacketsLost.store(0, std::memory_order_relaxed);
+    txPacketsLost.store(0, std::memory_order_relaxed);
     txBatchSize = 1;
     rxBatchSize = 1;
+    txLinkTransfers = 0;
+    rxLinkTransfers = 0;
     streamSize = 1;
 }
 
@@ -173,21 +757,36 @@ Streamer::~Streamer()
 StreamChannel* Streamer::SetupStream(const StreamConfig& config)
 {
     const int ch = config.channelID&1;
+    std::vector<StreamChannel>& streams = config.isTx ? mTxStreams : mRxStreams;
 
-    if ((config.isTx && mTxStreams[ch].used) || (!config.isTx && mRxStreams[ch].used))
+    if (streams[ch].used || (config.jointChannels && streams[1].used))
     {
         lime::error("Setup Stream: Channel already in use");
         return nullptr;
     }
+    if (config.jointChannels && ch != 0)
+    {
+        lime::error("Setup Stream: joint stream has to start at even channel");
+        return nullptr;
+    }
 
     if (txThread.joinable() || rxThread.joinable())
     {
-        if ((!mTxStreams[ch].used) && (!mRxStreams[ch].used))
+        if (((!mTxStreams[ch].used) && (!mRxStreams[ch].used))
+            || (config.jointChannels && (!mTxStreams[1].used) && (!mRxStreams[1].used)))
         {
             lime::warning("Stopping data stream to set up a new stream");
             UpdateThreads(true);
         }
-        if (config.format != dataLinkFormat)
+        if (dataLinkFormat == StreamConfig::FMT_INT8)
+        {
+            if (config.linkFormat != StreamConfig::FMT_INT8)
+            {
+                lime::error("Stream setup failed: stream is already running with 8bit link format");
+                return nullptr;
+            }
+        }
+        else if (config.format != dataLinkFormat)
         {
             if (dataLinkFormat == StreamConfig::FMT_INT12)
             {
@@ -199,34 +798,75 @@ StreamChannel* Streamer::SetupStream(const StreamConfig& config)
         }
     }
 
-    if(config.isTx)
-        mTxStreams[ch].Setup(config);
-    else
-        mRxStreams[ch].Setup(config);
+    streams[ch].Setup(config);
+    if (config.jointChannels)
+    {
+        //second channel is carried by the joint FIFO, it is only marked as used
+        streams[1].config = config;
+        streams[1].config.jointChannels = false;
+        streams[1].used = true;
+    }
 
     double rate = lms->GetSampleRate(config.isTx,LMS7002M::ChA)/1e6;
     streamSize = (mTxStreams[0].used||mRxStreams[0].used) + (mTxStreams[1].used||mRxStreams[1].used);
 
+    if (config.isTx)
+        mTxStreams[ch].burstLead = config.burstLeadTime * rate * 1e6;
+
     rate = (rate + 5) * config.performanceLatency * streamSize;
-    for (int batch = 1; batch < rate; batch <<= 1)
+    for (unsigned batch = 1; batch < rate && batch <= maxTransferPackets; batch <<= 1)
         if (config.isTx)
             txBatchSize = batch;
         else
             rxBatchSize = batch;
 
+    const unsigned transferSize = config.linkTransferSize ? config.linkTransferSize : GetEnvUnsigned("LIME_STREAM_TRANSFER_SIZE");
+    if (transferSize)
+    {
+        const unsigned batch = std::min<unsigned>(std::max<unsigned>(1, transferSize/sizeof(FPGA_DataPacket)), maxTransferPackets);
+        if (config.isTx)
+            txBatchSize = batch;
+        else
+            rxBatchSize = batch;
+    }
+    const unsigned transfers = config.linkTransfers ? config.linkTransfers : GetEnvUnsigned("LIME_STREAM_TRANSFERS");
+    if (transfers)
+    {
+        if (config.isTx)
+            txLinkTransfers = transfers;
+        else
+            rxLinkTransfers = transfers;
+    }
+
     return config.isTx ? &mTxStreams[ch] : &mRxStreams[ch]; //success
 }
 
-void Streamer::ResizeChannelBuffers()
+/** @brief Selects link format for used streams
+    8 bit link is used if all streams request it, 12 bit if all streams
+    use FMT_INT12 data format, 16 bit otherwise.
+*/
+StreamConfig::StreamDataFormat Streamer::SelectLinkFormat() const
 {
-    int pktSize = samples12InPkt/streamSize;
-    for(auto& i : mRxStreams)
-        if(i.used && i.config.format != StreamConfig::FMT_INT12)
-           pktSize = samples16InPkt/streamSize;
-    for(auto& i : mTxStreams)
-        if(i.used && i.config.format != StreamConfig::FMT_INT12)
-            pktSize = samples16InPkt/streamSize;
+    int used = 0;
+    bool all8 = true;
+    bool all12 = true;
+    for (const auto* streams : {&mRxStreams, &mTxStreams})
+        for (const auto& i : *streams)
+        {
+            if (!i.used)
+                continue;
+            ++used;
+            all8 &= i.config.linkFormat == StreamConfig::FMT_INT8;
+            all12 &= i.config.format == StreamConfig::FMT_INT12;
+        }
+    if (used && all8)
+        return StreamConfig::FMT_INT8;
+    return all12 ? StreamConfig::FMT_INT12 : StreamConfig::FMT_INT16;
+}
 
+void Streamer::ResizeChannelBuffers()
+{
+    const int pktSize = LinkSamplesInPacket(SelectLinkFormat(), streamSize);
     for(auto& i : mRxStreams)
         if(i.used && i.fifo)
             i.fifo->Resize(pktSize);
@@ -238,15 +878,7 @@ void Streamer::ResizeChannelBuffers()
 int Streamer::GetStreamSize(bool tx)
 {
     int batchSize = (tx ? txBatchSize : rxBatchSize)/streamSize;
-    for(auto &i : mRxStreams)
-        if(i.used && i.config.format != StreamConfig::FMT_INT12)
-            return samples16InPkt*batchSize;
-
-    for(auto &i : mTxStreams)
-        if(i.used && i.config.format != StreamConfig::FMT_INT12)
-            return samples16InPkt*batchSize;
-
-    return samples12InPkt*batchSize;
+    return LinkSamplesInPacket(SelectLinkFormat(), 1)*batchSize;
 }
 
 uint64_t Streamer::GetHardwareTimestamp(void)
@@ -532,6 +1164,81 @@ void Streamer::AlignQuadrature(bool restoreValues)
         lime::warning("Channel alignment failed");
 }
 
+/** @brief Returns thread settings for worker thread serving given streams,
+    the first used stream requesting non default settings takes precedence
+*/
+static const StreamConfig* GetThreadConfig(const std::vector<StreamChannel>& streams)
+{
+    const StreamConfig* config = nullptr;
+    for(auto &i : streams)
+    {
+        if (!i.used)
+            continue;
+        if (!i.config.threadCpus.empty() || i.config.threadPolicy != StreamConfig::THREAD_DEFAULT || !i.config.threadName.empty())
+            return &i.config;
+        if (config == nullptr)
+            config = &i.config;
+    }
+    return config;
+}
+
+/** @brief Applies CPU affinity, scheduling policy and name to stream worker thread.
+    Failures are logged, thread keeps running with default settings.
+*/
+static void ConfigureThread(std::thread& thread, const StreamConfig* config, const char* defaultName, const char* suffix = "")
+{
+    std::string name = (config && !config->threadName.empty()) ? config->threadName : defaultName;
+    name += suffix;
+#ifdef __unix__
+    pthread_t handle = thread.native_handle();
+    int ret = 0;
+#ifdef __linux__
+    //names are limited to 16 characters including terminator
+    ret = pthread_setname_np(handle, name.substr(0, 15).c_str());
+    if (ret != 0)
+        lime::warning("Failed to set stream thread name '%s': %s", name.c_str(), strerror(ret));
+#endif
+    if (config == nullptr)
+        return;
+    if (!config->threadCpus.empty())
+    {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu : config->threadCpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &cpus);
+        ret = pthread_setaffinity_np(handle, sizeof(cpus), &cpus);
+        if (ret != 0)
+            lime::warning("Failed to set %s thread CPU affinity: %s", name.c_str(), strerror(ret));
+#else
+        lime::warning("Stream thread CPU affinity is not supported on this platform");
+#endif
+    }
+    if (config->threadPolicy != StreamConfig::THREAD_DEFAULT)
+    {
+        const int policy = config->threadPolicy == StreamConfig::THREAD_FIFO ? SCHED_FIFO : SCHED_RR;
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = config->threadPriority;
+        const int minPriority = sched_get_priority_min(policy);
+        const int maxPriority = sched_get_priority_max(policy);
+        if (param.sched_priority < minPriority || param.sched_priority > maxPriority)
+        {
+            lime::warning("Stream thread priority %i out of range [%i, %i], clamping", param.sched_priority, minPriority, maxPriority);
+            param.sched_priority = param.sched_priority < minPriority ? minPriority : maxPriority;
+        }
+        ret = pthread_setschedparam(handle, policy, &param);
+        if (ret != 0)
+            lime::warning("Failed to set %s thread real-time priority: %s%s", name.c_str(), strerror(ret),
+                          ret == EPERM ? " (CAP_SYS_NICE or rtprio limit required)" : "");
+    }
+#else
+    if (config && (!config->threadCpus.empty() || config->threadPolicy != StreamConfig::THREAD_DEFAULT))
+        lime::warning("Stream thread affinity and scheduling settings are not supported on this platform");
+#endif
+}
+
 int Streamer::UpdateThreads(bool stopAll)
 {
     bool needTx = false;
@@ -581,25 +1288,13 @@ int Streamer::UpdateThreads(bool stopAll)
         //Clear device stream buffers
         dataPort->ResetStreamBuffers();
 
-        //enable MIMO mode, 12 bit compressed values
-        dataLinkFormat = StreamConfig::FMT_INT12;
-        //by default use 12 bit compressed, adjust link format for stream
-
-        for(auto &i : mRxStreams)
-            if(i.used && i.config.format != StreamConfig::FMT_INT12)
-            {
-                dataLinkFormat = StreamConfig::FMT_INT16;
-                break;
-            }
-
-        for(auto &i : mTxStreams)
-            if(i.used && i.config.format != StreamConfig::FMT_INT12)
-            {
-                dataLinkFormat = StreamConfig::FMT_INT16;
-                break;
-            }
-
-        const uint16_t smpl_width = dataLinkFormat == StreamConfig::FMT_INT12 ? 2 : 0;
+        dataLinkFormat = SelectLinkFormat();
+        //sample width: 0 - 16 bit, 2 - 12 bit compressed, 3 - 8 bit
+        uint16_t smpl_width = 0;
+        if (dataLinkFormat == StreamConfig::FMT_INT12)
+            smpl_width = 2;
+        else if (dataLinkFormat == StreamConfig::FMT_INT8)
+            smpl_width = 3;
         uint16_t mode = 0x0100;
 
         if (lms->Get_SPI_Reg_bits(LMS7param(LML1_SISODDR)))
@@ -633,6 +1328,7 @@ int Streamer::UpdateThreads(bool stopAll)
         terminateRx.store(false, std::memory_order_relaxed);
         auto RxLoopFunction = std::bind(&Streamer::ReceivePacketsLoop, this);
         rxThread = std::thread(RxLoopFunction);
+        ConfigureThread(rxThread, GetThreadConfig(mRxStreams), "lime-rx");
     }
     if(needTx && (!txThread.joinable()))
     {
@@ -641,36 +1337,258 @@ int Streamer::UpdateThreads(bool stopAll)
         terminateTx.store(false, std::memory_order_relaxed);
         auto TxLoopFunction = std::bind(&Streamer::TransmitPacketsLoop, this);
         txThread = std::thread(TxLoopFunction);
+        ConfigureThread(txThread, GetThreadConfig(mTxStreams), "lime-tx");
     }
     return 0;
 }
 
+/** @brief Adjusts packets per link transfer and transfers in flight of a stream loop.
+    Batch follows measured sample rate the same way SetupStream() derives it from
+    configured sample rate, and is doubled while device reports lost packets or loop
+    thread is busy most of the time. When batch is at its limit and packets are still
+    lost, more transfers are kept in flight. Settings relax back after a period without losses.
+*/
+class LinkTuner
+{
+public:
+    LinkTuner(const char* name, float latency, int streamSize, int batch, int maxBatch, int inFlight, int maxInFlight) :
+        batch(batch),
+        inFlight(inFlight),
+        name(name),
+        latency(latency),
+        streamSize(streamSize),
+        maxBatch(maxBatch),
+        minInFlight(inFlight),
+        maxInFlight(maxInFlight),
+        boost(0),
+        stablePeriods(0),
+        fifoWarned(false)
+    {
+    }
+
+    /** @brief Evaluates statistics of last measurement period
+        @param dataRate link data rate in bytes per second
+        @param samplesInPacket samples of one channel in link packet
+        @param lost packets lost during period
+        @param busyRatio part of period loop thread spent not waiting for link
+        @param fifoFill fill level of most filled channel FIFO, 0.0-1.0
+        @return true if batch or inFlight changed
+    */
+    bool Update(double dataRate, int samplesInPacket, uint32_t lost, double busyRatio, double fifoFill)
+    {
+        if (fifoFill > 0.9 && !fifoWarned)
+            lime::warning("%s auto-tune: FIFO %.0f%% full, application is not keeping up with stream", name, fifoFill*100);
+        fifoWarned = fifoFill > 0.5 && (fifoWarned || fifoFill > 0.9);
+
+        const double rateMHz = dataRate / sizeof(FPGA_DataPacket) * samplesInPacket / 1e6;
+        if (rateMHz <= 0)
+            return false; //not streaming, nothing to measure
+
+        int base = 1;
+        for (int b = 1; b < (rateMHz + 5) * latency * streamSize; b <<= 1)
+            base = b;
+
+        int newInFlight = inFlight;
+        if (lost > 0 || busyRatio > 0.95)
+        {
+            stablePeriods = 0;
+            if ((base << boost) < maxBatch)
+                ++boost;
+            else if (lost > 0)
+                newInFlight = std::min(inFlight*2, maxInFlight);
+        }
+        else if (++stablePeriods >= relaxPeriods)
+        {
+            stablePeriods = 0;
+            if (inFlight > minInFlight)
+                newInFlight = std::max(inFlight/2, minInFlight);
+            else if (boost > 0)
+                --boost;
+        }
+        const int newBatch = std::min(base << boost, maxBatch);
+
+        if (newBatch == batch && newInFlight == inFlight)
+            return false;
+        lime::info("%s auto-tune: %i packets per transfer, %i transfers in flight (%.2f MSps, %u packets lost, %.0f%% busy)",
+            name, newBatch, newInFlight, rateMHz, lost, busyRatio*100);
+        batch = newBatch;
+        inFlight = newInFlight;
+        return true;
+    }
+
+    int batch;
+    int inFlight;
+private:
+    static const int relaxPeriods = 10;
+    const char* name;
+    const float latency;
+    const int streamSize;
+    const int maxBatch;
+    const int minInFlight;
+    const int maxInFlight;
+    int boost;
+    int stablePeriods;
+    bool fifoWarned;
+};
+
+/** @brief Memory for link transfers of a stream loop.
+    Borrows buffer from connection when it provides memory it can transfer without
+    copying (IConnection::AllocateStreamBuffer()), allocates regular memory otherwise.
+*/
+class LinkBuffers
+{
+public:
+    LinkBuffers(IConnection* port, size_t size) :
+        port(port),
+        size(size),
+        data(port->AllocateStreamBuffer(size))
+    {
+        if (data == nullptr)
+        {
+            owned.resize(size);
+            data = owned.data();
+        }
+        memset(data, 0, size);
+    }
+    ~LinkBuffers()
+    {
+        if (owned.empty())
+            port->FreeStreamBuffer(data, size);
+    }
+    char& operator[](size_t index) { return data[index]; }
+private:
+    LinkBuffers(const LinkBuffers&) = delete;
+    LinkBuffers& operator=(const LinkBuffers&) = delete;
+    IConnection* port;
+    size_t size;
+    char* data;
+    std::vector<char> owned;
+};
+
+/** @brief Returns stream configuration that controls auto-tuning of the loop, or nullptr if it is disabled
+*/
+static const StreamConfig* GetTuneConfig(const std::vector<StreamChannel>& streams)
+{
+    for(auto &i : streams)
+        if (i.used && i.config.autoTune)
+            return &i.config;
+    return nullptr;
+}
+
+/** @brief Returns fill level of the most filled FIFO of active channels, 0.0-1.0
+*/
+static double GetFifoFill(const std::vector<StreamChannel>& streams)
+{
+    double fill = 0;
+    for(auto &i : streams)
+        if (i.used && i.mActive && i.fifo)
+        {
+            RingFIFO::BufferInfo info = i.fifo->GetInfo(false);
+            if (info.size)
+                fill = std::max(fill, double(info.itemsFilled)/info.size);
+        }
+    return fill;
+}
+
+/** @brief Follows Tx bursts taken from channel FIFO in timestamp order and checks them against hardware time.
+    Burst whose start is earlier than hardware time plus channel lead time is reported late,
+    and with StreamConfig::dropLateBursts its packets are dropped until burst end,
+    or until stream catches up with hardware time if burst has no end.
+    Bursts that reach their end are acknowledged.
+*/
+class TxBurstScheduler
+{
+public:
+    TxBurstScheduler() : inBurst(false), dropping(false), burstTimestamp(0) {}
+
+    void Reset()
+    {
+        inBurst = false;
+        dropping = false;
+    }
+
+    /** @brief Checks link packet assembled from channel FIFOs
+        All channels share the decision, so a packet is sent or dropped as a whole.
+        @param channels Tx channels that supplied samples, the first one provides timing settings
+        @param count number of channels
+        @param packet packet of the first channel, it provides packet header
+        @param hwTime latest hardware timestamp, 0 if unknown
+        @return true if packet should be sent, false if it is dropped
+    */
+    bool Check(StreamChannel* const* channels, int count, const SamplesPacket& packet, uint64_t hwTime)
+    {
+        const bool known = hwTime != 0;
+        const uint64_t burstLead = channels[0]->burstLead;
+        if (!inBurst)
+        {
+            inBurst = true;
+            dropping = false;
+            burstTimestamp = packet.timestamp;
+            if ((packet.flags & RingFIFO::SYNC_TIMESTAMP) && known && packet.timestamp < hwTime + burstLead)
+            {
+                dropping = channels[0]->config.dropLateBursts;
+                for (int i = 0; i < count; ++i)
+                    channels[i]->ReportBurst(StreamChannel::BurstEvent::BURST_LATE, burstTimestamp, hwTime, dropping);
+            }
+        }
+        else if (dropping && known && packet.timestamp >= hwTime + burstLead)
+            dropping = false;
+
+        const bool send = !dropping;
+        if (packet.flags & RingFIFO::END_BURST)
+        {
+            if (send)
+                for (int i = 0; i < count; ++i)
+                    channels[i]->ReportBurst(StreamChannel::BurstEvent::BURST_ACK, burstTimestamp, hwTime);
+            Reset();
+        }
+        return send;
+    }
+private:
+    bool inBurst;
+    bool dropping;
+    uint64_t burstTimestamp;
+};
+
 void Streamer::TransmitPacketsLoop()
 {
     //at this point FPGA has to be already configured to output samples
     const uint8_t maxChannelCount = 2;
     const uint8_t chCount = streamSize;
-    const bool packed = dataLinkFormat == StreamConfig::FMT_INT12;
+    const StreamConfig::StreamDataFormat linkFormat = dataLinkFormat;
+    const bool packed = linkFormat == StreamConfig::FMT_INT12;
     const int epIndex = chipId;
-    const uint8_t buffersCount = dataPort->GetBuffersCount();
-    const uint8_t packetsToBatch = dataPort->CheckStreamSize(txBatchSize);
-    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
-
-    const int maxSamplesBatch = (packed ? samples12InPkt:samples16InPkt)/chCount;
+    const int buffersCount = txLinkTransfers ? dataPort->CheckBuffersCount(txLinkTransfers) : dataPort->GetBuffersCount();
+    const StreamConfig* tuneConfig = GetTuneConfig(mTxStreams);
+    int packetsToBatch = dataPort->CheckStreamSize(txBatchSize);
+    //with auto-tuning buffers are allocated for the largest batch
+    const int maxBatch = tuneConfig ? dataPort->CheckStreamSize(std::max(packetsToBatch, 64)) : packetsToBatch;
+    const uint32_t bufferSize = maxBatch*sizeof(FPGA_DataPacket);
+    int activeCount = tuneConfig ? (buffersCount+1)/2 : buffersCount; //buffers used for transfers
+    LinkTuner tuner("Tx", tuneConfig ? tuneConfig->performanceLatency : 0, chCount, packetsToBatch, maxBatch, activeCount, buffersCount);
+    bool tunePending = false;
+    uint32_t lostCount = txPacketsLost.load(std::memory_order_relaxed);
+    double busyRatio = 0;
+    auto busyTime = std::chrono::high_resolution_clock::duration::zero();
+
+    const int maxSamplesBatch = LinkSamplesInPacket(linkFormat, chCount);
     std::vector<int> handles(buffersCount, 0);
     std::vector<bool> bufferUsed(buffersCount, 0);
     std::vector<uint32_t> bytesToSend(buffersCount, 0);
-    std::vector<char> buffers;
-    buffers.resize(buffersCount*bufferSize, 0);
+    LinkBuffers buffers(dataPort, buffersCount*bufferSize);
     std::vector<SamplesPacket> packets;
     for (int i = 0; i<maxChannelCount; ++i)
+    {
         packets.emplace_back(maxSamplesBatch);
+        memset(packets[i].samples, 0, maxSamplesBatch*sizeof(complex16_t));
+    }
+    TxBurstScheduler scheduler;
 
     long totalBytesSent = 0;
     auto t1 = std::chrono::high_resolution_clock::now();
     auto t2 = t1;
     bool end_burst = false;
-    uint8_t bi = 0; //buffer index
+    int bi = 0; //buffer index
     while (terminateTx.load(std::memory_order_relaxed) != true)
     {
         if (bufferUsed[bi])
@@ -691,10 +1609,17 @@ void Streamer::TransmitPacketsLoop()
         bytesToSend[bi] = 0;
         FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(&buffers[bi*bufferSize]);
         int i=0;
-        do
+        end_burst = false;
+        while (i<packetsToBatch && end_burst == false)
         {
-            bool has_samples = false;
             int payloadSize = sizeof(FPGA_DataPacket::data);
+            //packets are read directly from FIFOs, scratch packets are used for idle channels
+            SamplesPacket* txPackets[maxChannelCount] = {&packets[0], &packets[1]};
+            RingFIFO* fifos[maxChannelCount] = {nullptr, nullptr};
+            StreamChannel* sources[maxChannelCount];
+            const SamplesPacket* header = nullptr; //packet providing timestamp and flags
+            int sourcesCount = 0;
+            bool anyActive = false;
             for(int ch=0; ch<maxChannelCount; ++ch)
             {
                 if (!mTxStreams[ch].used)
@@ -705,48 +1630,102 @@ void Streamer::TransmitPacketsLoop()
                     memset(packets[ind].samples,0,maxSamplesBatch*sizeof(complex16_t));
                     continue;
                 }
-                mTxStreams[ch].fifo->pop_packet(packets[ind]);
-                int samplesPopped = packets[ind].last;
+                anyActive = true;
+                SamplesPacket* txPacket = mTxStreams[ch].fifo->begin_pop_packet(100);
+                if (txPacket == nullptr)
+                    continue;
+                int samplesPopped = txPacket->last;
                 if (samplesPopped != maxSamplesBatch)
                 {
-                    if (!(packets[ind].flags & RingFIFO::END_BURST))
+                    if (!(txPacket->flags & RingFIFO::END_BURST))
+                    {
+                        mTxStreams[ch].fifo->end_pop_packet();
                         continue;
+                    }
                     payloadSize = samplesPopped * sizeof(FPGA_DataPacket::data) / maxSamplesBatch;
                     int q = packed ? 48 : 16;
                     payloadSize = (1 + (payloadSize - 1) / q) * q;
-                    memset(&packets[ind].samples[samplesPopped], 0, (maxSamplesBatch - samplesPopped)*sizeof(complex16_t));
+                    for (int j = 0; j < mTxStreams[ch].GetChannelCount(); ++j)
+                        memset(&txPacket->samples[j*mTxStreams[ch].fifo->GetChannelStride() + samplesPopped], 0, (maxSamplesBatch - samplesPopped)*sizeof(complex16_t));
                 }
-                has_samples = true;
+                txPackets[ind] = txPacket;
+                fifos[ch] = mTxStreams[ch].fifo;
+                sources[sourcesCount++] = &mTxStreams[ch];
+                if (header == nullptr)
+                    header = txPacket;
             }
+            if (!anyActive)
+                scheduler.Reset();
 
-            if (!has_samples)
+            if (header == nullptr)
                 break;
 
-            end_burst = (packets[0].flags & RingFIFO::END_BURST);
-            pkt[i].counter = packets[0].timestamp;
+            //late bursts are dropped for all channels, so that channels stay aligned
+            if (!scheduler.Check(sources, sourcesCount, *header, rxLastTimestamp.load(std::memory_order_relaxed)))
+            {
+                for(int ch=0; ch<maxChannelCount; ++ch)
+                    if (fifos[ch])
+                        fifos[ch]->end_pop_packet();
+                continue;
+            }
+
+            end_burst = (header->flags & RingFIFO::END_BURST);
+            pkt[i].counter = header->timestamp;
             pkt[i].reserved[0] = 0;
             //by default ignore timestamps
-            const int ignoreTimestamp = !(packets[0].flags & RingFIFO::SYNC_TIMESTAMP);
+            const int ignoreTimestamp = !(header->flags & RingFIFO::SYNC_TIMESTAMP);
             pkt[i].reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
             pkt[i].reserved[1] = payloadSize & 0xFF;
             pkt[i].reserved[2] = (payloadSize >> 8) & 0xFF;
-            std::vector<complex16_t*> src(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                src[c] = (packets[c].samples);
+            complex16_t* src[maxChannelCount] = {txPackets[0]->samples, txPackets[1]->samples};
+            if (fifos[0] && mTxStreams[0].config.jointChannels) //both channels come from one packet
+                src[1] = txPackets[0]->samples + fifos[0]->GetChannelStride();
             uint8_t* const dataStart = (uint8_t*)pkt[i].data;
-            FPGA::Samples2FPGAPacketPayload(src.data(), maxSamplesBatch, chCount==2, packed, dataStart);
+            const auto packStart = std::chrono::high_resolution_clock::now();
+            if (linkFormat == StreamConfig::FMT_INT8)
+                SamplesToPayload8(GetPacketCodec(), src, maxSamplesBatch, chCount==2, dataStart);
+            else
+                FPGA::Samples2FPGAPacketPayload(src, maxSamplesBatch, chCount==2, packed, dataStart);
+            busyTime += std::chrono::high_resolution_clock::now() - packStart;
             bytesToSend[bi] += 16+payloadSize;
-        }while(++i<packetsToBatch && end_burst == false);
+            for(int ch=0; ch<maxChannelCount; ++ch)
+                if (fifos[ch])
+                    fifos[ch]->end_pop_packet();
+            ++i;
+        }
 
         if(terminateTx.load(std::memory_order_relaxed) == true) //early termination
             break;
 
         if (i)
         {
+            for(int ch=0; ch<maxChannelCount; ++ch)
+                if (mTxStreams[ch].used && mTxStreams[ch].mActive)
+                    mTxStreams[ch].NotifyEvent();
             handles[bi] = dataPort->BeginDataSending(&buffers[bi*bufferSize], bytesToSend[bi], epIndex);
             txLastTimestamp.store(pkt[i-1].counter+maxSamplesBatch-1, std::memory_order_relaxed); //timestamp of the last sample that was sent to HW
             bufferUsed[bi] = true;
-            bi = (bi + 1) & (buffersCount-1);
+            if (++bi == activeCount)
+            {
+                bi = 0;
+                //transfer settings are changed at buffer wrap, so that transfers keep their order
+                if (tunePending && tuner.Update(txDataRate_Bps.load(std::memory_order_relaxed), maxSamplesBatch,
+                    txPacketsLost.load(std::memory_order_relaxed) - lostCount, busyRatio, GetFifoFill(mTxStreams)))
+                {
+                    packetsToBatch = std::min(dataPort->CheckStreamSize(tuner.batch), maxBatch);
+                    //complete transfers of buffers that are no longer used
+                    for (int j = tuner.inFlight; j < activeCount; ++j)
+                        if (bufferUsed[j] && dataPort->WaitForSending(handles[j], 1000))
+                        {
+                            totalBytesSent += dataPort->FinishDataSending(&buffers[j*bufferSize], bytesToSend[j], handles[j]);
+                            bufferUsed[j] = false;
+                        }
+                    activeCount = tuner.inFlight;
+                }
+                if (tunePending)
+                    lostCount = txPacketsLost.load(std::memory_order_relaxed);
+                tunePending = false;
+            }
         }
 
         t2 = std::chrono::high_resolution_clock::now();
@@ -757,6 +1736,9 @@ void Streamer::TransmitPacketsLoop()
             float dataRate = 1000.0*totalBytesSent / timePeriod;
             txDataRate_Bps.store(dataRate, std::memory_order_relaxed);
             totalBytesSent = 0;
+            busyRatio = std::chrono::duration<double, std::milli>(busyTime).count() / timePeriod;
+            busyTime = busyTime.zero();
+            tunePending = tuneConfig != nullptr;
             t1 = t2;
 #ifndef NDEBUG
             lime::log(LOG_LEVEL_DEBUG, "Tx: %.3f MB/s\n", dataRate / 1000000.0);
@@ -769,30 +1751,202 @@ void Streamer::TransmitPacketsLoop()
     txDataRate_Bps.store(0, std::memory_order_relaxed);
 }
 
+/** @brief Checks received packets for lost data and pushes their samples to Rx FIFOs
+*/
+class RxPacketParser
+{
+public:
+    RxPacketParser(Streamer* streamer, int buffersCount) :
+        mStreamer(streamer),
+        chCount(streamer->streamSize),
+        linkFormat(streamer->dataLinkFormat),
+        packed(linkFormat == StreamConfig::FMT_INT12),
+        samplesInPacket(LinkSamplesInPacket(linkFormat, chCount)),
+        resetFlagsDelayInit(buffersCount*2),
+        resetFlagsDelay(0),
+        prevTs(0),
+        prevTsValid(false)
+    {
+        //scratch frames for channels that are not streaming or whose FIFO drops packet
+        for (int i = 0; i<maxChannelCount; ++i)
+            chFrames.emplace_back(samplesInPacket);
+    }
+
+    void Parse(const char* buffer, const int32_t bytesReceived)
+    {
+        std::vector<StreamChannel>& rxStreams = mStreamer->mRxStreams;
+        const FPGA_DataPacket* pkt = (const FPGA_DataPacket*)buffer;
+        bool packetsLost = false;
+        const int packetsCount = bytesReceived / int(sizeof(FPGA_DataPacket));
+        for (int pktIndex = 0; pktIndex < packetsCount; ++pktIndex)
+        {
+            const uint8_t byte0 = pkt[pktIndex].reserved[0];
+            if ((byte0 & (1 << 3)) != 0)
+            {
+                if(resetFlagsDelay > 0)
+                    --resetFlagsDelay;
+                else
+                {
+                    lime::debug("L");
+                    resetFlagsDelay = resetFlagsDelayInit;
+                }
+                for(auto &value: mStreamer->mTxStreams)
+                    if (value.used && value.mActive)
+                        value.pktLost++;
+                mStreamer->txPacketsLost.fetch_add(1, std::memory_order_relaxed);
+            }
+            uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
+            if(prevTsValid && pkt[pktIndex].counter - prevTs != samplesInPacket && pkt[pktIndex].counter != prevTs)
+            {
+                int packetLoss = ((pkt[pktIndex].counter - prevTs)/samplesInPacket)-1;
+                for(auto &value: rxStreams)
+                    if (value.used && value.mActive)
+                    {
+                        value.pktLost += packetLoss;
+                        if (packetLoss > 0)
+                            value.ReportGap(prevTs + samplesInPacket, packetLoss*samplesInPacket, StreamChannel::Gap::GAP_LINK);
+                    }
+                mStreamer->rxPacketsLost.fetch_add(packetLoss, std::memory_order_relaxed);
+                packetsLost = true;
+            }
+            prevTs = pkt[pktIndex].counter;
+            prevTsValid = true;
+            mStreamer->rxLastTimestamp.store(prevTs, std::memory_order_relaxed);
+
+            //unpack samples directly to FIFO packets
+            SamplesPacket* frames[maxChannelCount] = {&chFrames[0], &chFrames[1]};
+            RingFIFO* fifos[maxChannelCount] = {nullptr, nullptr};
+            for(int ch=0; ch<maxChannelCount; ++ch)
+            {
+                if (rxStreams[ch].used==false || rxStreams[ch].mActive==false)
+                    continue;
+                const int ind = chCount == maxChannelCount ? ch : 0;
+                RingFIFO::Gap evicted;
+                SamplesPacket* frame = rxStreams[ch].fifo->begin_push_packet(&evicted);
+                if (evicted.samplesCount > 0)
+                    rxStreams[ch].ReportGap(evicted.timestamp, evicted.samplesCount, StreamChannel::Gap::GAP_OVERFLOW);
+                if (frame == nullptr)
+                {
+                    rxStreams[ch].ReportGap(pkt[pktIndex].counter, samplesInPacket, StreamChannel::Gap::GAP_OVERFLOW);
+                    continue;
+                }
+                frames[ind] = frame;
+                fifos[ch] = rxStreams[ch].fifo;
+            }
+            complex16_t* dest[maxChannelCount] = {frames[0]->samples, frames[1]->samples};
+            if (fifos[0] && rxStreams[0].config.jointChannels) //both channels go to one packet
+                dest[1] = frames[0]->samples + fifos[0]->GetChannelStride();
+            int samplesCount;
+            if (linkFormat == StreamConfig::FMT_INT8)
+                samplesCount = Payload8ToSamples(GetPacketCodec(), pktStart, 4080, chCount==2, dest);
+            else
+                samplesCount = FPGA::FPGAPacketPayload2Samples(pktStart, 4080, chCount==2, packed, dest);
+
+            for(int ch=0; ch<maxChannelCount; ++ch)
+            {
+                if (fifos[ch] == nullptr)
+                    continue;
+                const int ind = chCount == maxChannelCount ? ch : 0;
+                frames[ind]->timestamp = pkt[pktIndex].counter;
+                frames[ind]->last = samplesCount;
+                frames[ind]->flags = 0;
+                fifos[ch]->end_push_packet();
+            }
+        }
+        //once per buffer, FIFO overflow also passes threshold as FIFO is full then
+        for (auto &value : rxStreams)
+            if (value.used && value.mActive)
+            {
+                if (value.callback)
+                    value.RunCallback();
+                value.FlushGap();
+                value.NotifyEvent(packetsLost);
+            }
+    }
+
+private:
+    static const uint8_t maxChannelCount = 2;
+    Streamer* mStreamer;
+    const uint8_t chCount;
+    const StreamConfig::StreamDataFormat linkFormat;
+    const bool packed;
+    const uint32_t samplesInPacket;
+    const int resetFlagsDelayInit;
+    int resetFlagsDelay;
+    uint64_t prevTs;
+    bool prevTsValid; //false until the first packet, FPGA timestamp may already be running
+    std::vector<SamplesPacket> chFrames;
+};
+
 /** @brief Function dedicated for receiving data samples from board
-    @param stream a pointer to an active receiver stream
 */
 void Streamer::ReceivePacketsLoop()
 {
     //at this point FPGA has to be already configured to output samples
-    const uint8_t maxChannelCount = 2;
-    const uint8_t chCount = streamSize;
-    const bool packed = dataLinkFormat == StreamConfig::FMT_INT12;
-    const uint32_t samplesInPacket = (packed  ? samples12InPkt : samples16InPkt)/chCount;
-
     const int epIndex = chipId;
-    const uint8_t buffersCount = dataPort->GetBuffersCount();
-    const uint8_t packetsToBatch = dataPort->CheckStreamSize(rxBatchSize);
-    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
-    std::vector<int> handles(buffersCount, 0);
-    std::vector<char>buffers(buffersCount*bufferSize, 0);
-    std::vector<SamplesPacket> chFrames;
+    const int buffersCount = rxLinkTransfers ? dataPort->CheckBuffersCount(rxLinkTransfers) : dataPort->GetBuffersCount();
+    const StreamConfig* tuneConfig = GetTuneConfig(mRxStreams);
+    const int packetsToBatch = dataPort->CheckStreamSize(rxBatchSize);
+    //with auto-tuning buffers are allocated for the largest batch
+    const int maxBatch = tuneConfig ? dataPort->CheckStreamSize(std::max(packetsToBatch, 64)) : packetsToBatch;
+    const uint32_t bufferSize = maxBatch*sizeof(FPGA_DataPacket);
+    uint32_t transferSize = packetsToBatch*sizeof(FPGA_DataPacket);
+    int activeCount = tuneConfig ? (buffersCount+1)/2 : buffersCount; //transfers kept in flight
+    int nextActiveCount = activeCount;
+    const int samplesInPacket = LinkSamplesInPacket(dataLinkFormat, streamSize);
+    LinkTuner tuner("Rx", tuneConfig ? tuneConfig->performanceLatency : 0, streamSize, packetsToBatch, maxBatch, activeCount, buffersCount);
+    bool tunePending = false;
+    uint32_t lostCount = rxPacketsLost.load(std::memory_order_relaxed);
+    double busyRatio = 0;
+    auto waitTime = std::chrono::high_resolution_clock::duration::zero();
+
+    bool pipelined = false;
+    for(auto &i : mRxStreams)
+        if(i.used && i.config.pipelined)
+            pipelined = true;
 
-    for (int i = 0; i<maxChannelCount; ++i)
-        chFrames.emplace_back(samplesInPacket);
+    //in pipelined mode extra buffers hold received data while it waits for parsing
+    const int parseBuffersCount = pipelined ? 2*buffersCount : 0;
+    const int totalBuffersCount = buffersCount + parseBuffersCount;
+    std::vector<int> handles(buffersCount, 0);
+    std::vector<int> transferBuffer(buffersCount, 0);
+    std::vector<uint32_t> transferBytes(buffersCount, transferSize);
+    std::vector<int32_t> bytesInBuffer(totalBuffersCount, 0);
+    LinkBuffers buffers(dataPort, totalBuffersCount*bufferSize);
+    RxPacketParser parser(this, buffersCount);
+
+    SPSCQueue<int> filledBuffers(totalBuffersCount);
+    SPSCQueue<int> freeBuffers(totalBuffersCount);
+    for (int i = buffersCount; i<totalBuffersCount; ++i)
+        freeBuffers.push(i);
+    rxParseQueueFill.store(0, std::memory_order_relaxed);
+    rxParseQueuePeak.store(0, std::memory_order_relaxed);
+    rxParseQueueSize.store(parseBuffersCount, std::memory_order_relaxed);
+    rxLinkQueueSize.store(activeCount, std::memory_order_relaxed);
+
+    std::thread parserThread;
+    if (pipelined)
+        parserThread = std::thread([&]{
+            int index;
+            while (terminateRx.load(std::memory_order_relaxed) == false)
+            {
+                if (!filledBuffers.pop(index, 100))
+                    continue;
+                parser.Parse(&buffers[index*bufferSize], bytesInBuffer[index]);
+                freeBuffers.push(index);
+                rxParseQueueFill.store(filledBuffers.size(), std::memory_order_relaxed);
+            }
+        });
+    if (parserThread.joinable())
+        ConfigureThread(parserThread, GetThreadConfig(mRxStreams), "lime-rx", "-parse");
 
+    int inFlight = 0;
     for (int i = 0; i<buffersCount; ++i)
-        handles[i] = dataPort->BeginDataReading(&buffers[i*bufferSize], bufferSize, epIndex);
+    {
+        transferBuffer[i] = i;
+        handles[i] = i < activeCount ? dataPort->BeginDataReading(&buffers[i*bufferSize], transferSize, epIndex) : -1;
+        inFlight += handles[i] >= 0;
+    }
 
     int bi = 0;
     unsigned long totalBytesReceived = 0; //for data rate calculation
@@ -800,17 +1954,20 @@ void Streamer::ReceivePacketsLoop()
     auto t1 = std::chrono::high_resolution_clock::now();
     auto t2 = t1;
 
-    int resetFlagsDelay = 0;
-    uint64_t prevTs = 0;
     while (terminateRx.load(std::memory_order_relaxed) == false)
     {
         int32_t bytesReceived = 0;
+        char* buffer = &buffers[transferBuffer[bi]*bufferSize];
         if(handles[bi] >= 0)
         {
-            if (dataPort->WaitForReading(handles[bi], 1000) == true)
+            const auto waitStart = std::chrono::high_resolution_clock::now();
+            const bool ready = dataPort->WaitForReading(handles[bi], 1000);
+            waitTime += std::chrono::high_resolution_clock::now() - waitStart;
+            if (ready)
             {
-                bytesReceived = dataPort->FinishDataReading(&buffers[bi*bufferSize], bufferSize, handles[bi]);
+                bytesReceived = dataPort->FinishDataReading(buffer, transferBytes[bi], handles[bi]);
                 totalBytesReceived += bytesReceived;
+                --inFlight;
             }
             else
             {
@@ -819,52 +1976,56 @@ void Streamer::ReceivePacketsLoop()
                 continue;
             }
         }
-        for (uint8_t pktIndex = 0; pktIndex < bytesReceived / sizeof(FPGA_DataPacket); ++pktIndex)
+        if (!pipelined)
+            parser.Parse(buffer, bytesReceived);
+        else if (bytesReceived > 0)
         {
-            const FPGA_DataPacket* pkt = (FPGA_DataPacket*)&buffers[bi*bufferSize];
-            const uint8_t byte0 = pkt[pktIndex].reserved[0];
-            if ((byte0 & (1 << 3)) != 0)
+            //hand over filled buffer to parser and continue with a free one,
+            //if parser is behind, received data is dropped and shows up as packet loss
+            int freeIndex;
+            if (freeBuffers.pop(freeIndex, 0))
             {
-                if(resetFlagsDelay > 0)
-                    --resetFlagsDelay;
-                else
-                {
-                    lime::debug("L");
-                    resetFlagsDelay = buffersCount*2;
-                }
-                for(auto &value: mTxStreams)
-                    if (value.used && value.mActive)
-                        value.pktLost++;
+                bytesInBuffer[transferBuffer[bi]] = bytesReceived;
+                filledBuffers.push(transferBuffer[bi]);
+                transferBuffer[bi] = freeIndex;
+                buffer = &buffers[freeIndex*bufferSize];
+                const uint32_t fill = filledBuffers.size();
+                rxParseQueueFill.store(fill, std::memory_order_relaxed);
+                if (fill > rxParseQueuePeak.load(std::memory_order_relaxed))
+                    rxParseQueuePeak.store(fill, std::memory_order_relaxed);
             }
-            uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
-            if(pkt[pktIndex].counter - prevTs != samplesInPacket && pkt[pktIndex].counter != prevTs)
-            {
-                int packetLoss = ((pkt[pktIndex].counter - prevTs)/samplesInPacket)-1;
-                for(auto &value: mRxStreams)
-                    if (value.used && value.mActive)
-                        value.pktLost += packetLoss;
-            }
-            prevTs = pkt[pktIndex].counter;
-            rxLastTimestamp.store(prevTs, std::memory_order_relaxed);
-            //parse samples
-            std::vector<complex16_t*> dest(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                dest[c] = (chFrames[c].samples);
-            int samplesCount = FPGA::FPGAPacketPayload2Samples(pktStart, 4080, chCount==2, packed, dest.data());
-
-            for(int ch=0; ch<maxChannelCount; ++ch)
+        }
+        // Re-submit this request to keep the queue full, unless tuner is reducing transfers in flight
+        transferBytes[bi] = transferSize;
+        handles[bi] = bi < nextActiveCount ? dataPort->BeginDataReading(buffer, transferSize, epIndex) : -1;
+        inFlight += handles[bi] >= 0;
+        rxLinkQueueFill.store(inFlight, std::memory_order_relaxed);
+        if (++bi == activeCount)
+        {
+            bi = 0;
+            activeCount = nextActiveCount;
+            //transfer settings are changed at buffer wrap, so that transfers keep their order
+            if (tunePending && tuner.Update(rxDataRate_Bps.load(std::memory_order_relaxed), samplesInPacket,
+                rxPacketsLost.load(std::memory_order_relaxed) - lostCount, busyRatio, GetFifoFill(mRxStreams)))
             {
-                if (mRxStreams[ch].used==false || mRxStreams[ch].mActive==false)
-                    continue;
-                const int ind = chCount == maxChannelCount ? ch : 0;
-                chFrames[ind].timestamp = pkt[pktIndex].counter;
-                chFrames[ind].last = samplesCount;
-                mRxStreams[ch].fifo->push_packet(chFrames[ind]);
+                transferSize = std::min(dataPort->CheckStreamSize(tuner.batch), maxBatch)*sizeof(FPGA_DataPacket);
+                //added transfers are submitted after the last one of current cycle,
+                //removed ones are not resubmitted during next cycle
+                for (int i = activeCount; i < tuner.inFlight; ++i)
+                {
+                    transferBytes[i] = transferSize;
+                    handles[i] = dataPort->BeginDataReading(&buffers[transferBuffer[i]*bufferSize], transferSize, epIndex);
+                    inFlight += handles[i] >= 0;
+                }
+                if (tuner.inFlight > activeCount)
+                    activeCount = tuner.inFlight;
+                nextActiveCount = tuner.inFlight;
+                rxLinkQueueSize.store(nextActiveCount, std::memory_order_relaxed);
             }
+            if (tunePending)
+                lostCount = rxPacketsLost.load(std::memory_order_relaxed);
+            tunePending = false;
         }
-        // Re-submit this request to keep the queue full
-        handles[bi] = dataPort->BeginDataReading(&buffers[bi*bufferSize], bufferSize, epIndex);
-        bi = (bi + 1) & (buffersCount-1);
 
         t2 = std::chrono::high_resolution_clock::now();
         auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
@@ -878,10 +2039,17 @@ void Streamer::ReceivePacketsLoop()
 #endif
             totalBytesReceived = 0;
             rxDataRate_Bps.store((uint32_t)dataRate, std::memory_order_relaxed);
+            busyRatio = 1.0 - std::chrono::duration<double, std::milli>(waitTime).count() / timePeriod;
+            waitTime = waitTime.zero();
+            tunePending = tuneConfig != nullptr;
         }
     }
     dataPort->AbortReading(epIndex);
+    if (parserThread.joinable())
+        parserThread.join();
     rxDataRate_Bps.store(0, std::memory_order_relaxed);
+    rxLinkQueueFill.store(0, std::memory_order_relaxed);
+    rxParseQueueFill.store(0, std::memory_order_relaxed);
 }
 
 }
@@ -17,6 +17,8 @@
 #include "dataTypes.h"
 #include "fifo.h"
 #include <vector>
+#include <string>
+#include <functional>
 
 namespace lime
 {
@@ -31,7 +33,24 @@ class LMS7002M;
  */
 struct LIME_API StreamConfig
 {
-    StreamConfig(void){};
+    StreamConfig(void):
+        linkFormat(FMT_INT12),
+        fullScale(32767.0f),
+        pipelined(false),
+        threadPolicy(THREAD_DEFAULT),
+        threadPriority(0),
+        hugePages(false),
+        lockMemory(false),
+        autoTune(false),
+        burstLeadTime(0),
+        dropLateBursts(false),
+        jointChannels(false),
+        eventThreshold(0),
+        overflowPolicy(OVERFLOW_DROP_OLDEST),
+        overflowBlockTime(10),
+        gapHandling(GAP_CONCATENATE),
+        linkTransfers(0),
+        linkTransferSize(0){};
 
     //! True for transmit stream, false for receive
     bool isTx;
@@ -46,6 +65,9 @@ struct LIME_API StreamConfig
         FMT_INT16,
         FMT_INT12,
         FMT_FLOAT32,
+        FMT_INT16_PLANAR,   ///<FMT_INT16 with all I values followed by all Q values
+        FMT_FLOAT32_PLANAR, ///<FMT_FLOAT32 with all I values followed by all Q values
+        FMT_INT8,           ///<8 bit integers, most significant bits of link samples
     };
 
     /*!
@@ -55,7 +77,11 @@ struct LIME_API StreamConfig
      */
     size_t bufferLength;
 
-    //! The format of the samples in Read/WriteStream().
+    /*!
+     * The format of the samples in Read/WriteStream().
+     * In planar formats buffer of N samples holds N I values
+     * followed by N Q values, also when fewer samples are transferred.
+     */
     StreamDataFormat format;
 
     /*!
@@ -63,9 +89,153 @@ struct LIME_API StreamConfig
      * This is not the format presented to the API caller.
      * Choosing a compressed format can decrease link use
      * at the expense of additional processing on the PC
-     * Default: STREAM_12_BIT_IN_16
+     * FMT_INT8 selects 8 bit samples, used only if requested by all channels,
+     * it requires FPGA gateware supporting 8 bit sample width.
+     * Other values leave 12 or 16 bit selection to stream data formats.
+     * Default: FMT_INT12
      */
     StreamDataFormat linkFormat;
+
+    /*!
+     * Integer sample value corresponding to 1.0 in FMT_FLOAT32 format.
+     * Transmitted samples exceeding the link format range are clipped.
+     * Default: 32767
+     */
+    float fullScale;
+
+    /*!
+     * Receive with separate link transport and packet parsing threads,
+     * so that slow sample processing does not delay link transfers.
+     * Used if enabled for any of the Rx channels.
+     * Default: false
+     */
+    bool pipelined;
+
+    //! Scheduling policies for stream worker threads
+    enum ThreadPolicy
+    {
+        THREAD_DEFAULT, ///<OS default time sharing
+        THREAD_FIFO,    ///<SCHED_FIFO real-time
+        THREAD_RR,      ///<SCHED_RR real-time
+    };
+
+    /*!
+     * CPUs the Rx/Tx worker thread is allowed to run on.
+     * Threads are shared between channels of the same direction,
+     * settings of the first channel requesting them are used.
+     * Default: empty, no restriction
+     */
+    std::vector<int> threadCpus;
+
+    //! Scheduling policy of the worker thread. Default: THREAD_DEFAULT
+    ThreadPolicy threadPolicy;
+
+    //! Priority for real-time scheduling policies. Default: 0
+    int threadPriority;
+
+    //! Worker thread name. Default: empty, "lime-rx"/"lime-tx" is used
+    std::string threadName;
+
+    /*!
+     * Back stream FIFO with huge pages to reduce TLB misses,
+     * transparent huge pages are used if none are reserved.
+     * Default: false
+     */
+    bool hugePages;
+
+    //! Lock stream FIFO in RAM, so that it is never paged out. Default: false
+    bool lockMemory;
+
+    /*!
+     * Adjust packets per link transfer and number of transfers in flight
+     * while streaming, based on measured link rate, packet loss and
+     * worker thread load. Decisions are logged at info level.
+     * Used if enabled for any of the channels of the same direction.
+     * Default: false
+     */
+    bool autoTune;
+
+    /*!
+     * Minimum time in seconds between current hardware time and start
+     * of a timed Tx burst, for the burst to be considered on time.
+     * Converted to samples using sample rate at stream setup.
+     * Default: 0
+     */
+    double burstLeadTime;
+
+    /*!
+     * Drop Tx bursts that are late, instead of only reporting them,
+     * so that they do not use link bandwidth.
+     * Default: false
+     */
+    bool dropLateBursts;
+
+    /*!
+     * Stream both channels of the chip through one joint FIFO, so that
+     * they always have identical timestamps and sample counts.
+     * channelID selects the first (even) channel, samples are transferred
+     * with ReadMulti()/WriteMulti().
+     * Default: false
+     */
+    bool jointChannels;
+
+    /*!
+     * Create event file descriptor (StreamChannel::GetEventFd()) that becomes
+     * readable when at least this many samples can be read (Rx) or written (Tx),
+     * on Rx FIFO overflow or packet loss and on Tx burst events.
+     * Values above FIFO size are limited to FIFO size. Supported only on Linux.
+     * Default: 0, no event descriptor
+     */
+    uint32_t eventThreshold;
+
+    //! Handling of received packets when Rx FIFO is full
+    enum OverflowPolicy
+    {
+        OVERFLOW_DROP_OLDEST,   ///<drop the oldest samples in FIFO
+        OVERFLOW_DROP_NEWEST,   ///<drop the received samples
+        OVERFLOW_BLOCK,         ///<wait for space up to overflowBlockTime, then drop the received samples
+    };
+
+    /*!
+     * Rx FIFO overflow policy. Dropped samples are reported as gaps,
+     * see StreamChannel::ReadGap(). Blocking delays all Rx channels.
+     * Default: OVERFLOW_DROP_OLDEST
+     */
+    OverflowPolicy overflowPolicy;
+
+    //! Longest wait for Rx FIFO space in milliseconds with OVERFLOW_BLOCK. Default: 10
+    uint32_t overflowBlockTime;
+
+    //! Handling of lost Rx samples in Read()
+    enum GapHandling
+    {
+        GAP_CONCATENATE,    ///<samples around gaps are returned back to back
+        GAP_ZERO_FILL,      ///<zero samples are returned in place of lost ones
+        GAP_SPLIT,          ///<read ends at gap, next read has DISCONTINUITY metadata flag
+    };
+
+    /*!
+     * Rx timestamp gap handling, applies to Read()/ReadMulti().
+     * Gaps are also reported by StreamChannel::ReadGap().
+     * Default: GAP_CONCATENATE
+     */
+    GapHandling gapHandling;
+
+    /*!
+     * Number of link transfers kept in flight, limited by connection.
+     * More transfers tolerate longer scheduling delays of the stream thread,
+     * fewer transfers reduce latency. Applies to all channels of the same direction.
+     * Default: 0, LIME_STREAM_TRANSFERS environment variable or connection default
+     */
+    uint32_t linkTransfers;
+
+    /*!
+     * Size of a link transfer in bytes, rounded down to whole packets,
+     * at most 1 MiB (256 packets). Applies to all channels of the same direction.
+     * Default: 0, LIME_STREAM_TRANSFER_SIZE environment variable
+     * or selection based on performanceLatency
+     */
+    uint32_t linkTransferSize;
 };
 
 class LIME_API StreamChannel
@@ -87,8 +257,57 @@ public:
         float linkRate;
         int droppedPackets;
         uint64_t timestamp;
+        int clippedSamples;
+        int linkQueueFill;      //!< link transfers in flight
+        int linkQueueSize;
+        int parseQueueFill;     //!< pipelined Rx: received buffers waiting to be parsed
+        int parseQueuePeak;     //!< pipelined Rx: largest parseQueueFill since last GetInfo()
+        int parseQueueSize;
+        int lateBursts;         //!< Tx: bursts detected late since last GetInfo()
+        int gapsCount;          //!< Rx: gap records waiting to be read with ReadGap()
+    };
+
+    //! Tx burst status reported by stream thread
+    struct BurstEvent
+    {
+        enum Type
+        {
+            BURST_ACK,  ///<burst was handed to link
+            BURST_LATE, ///<burst start was behind hardware time plus lead time
+        };
+        Type type;
+        uint64_t timestamp; ///<timestamp of the first burst sample
+        uint64_t time;      ///<hardware time when event was generated
+        bool dropped;       ///<burst was not sent
     };
 
+    //! Range of Rx samples that were lost
+    struct Gap
+    {
+        enum Cause
+        {
+            GAP_LINK,       ///<packets lost on link or dropped by FPGA
+            GAP_OVERFLOW,   ///<samples dropped by host FIFO overflow policy
+        };
+        uint64_t timestamp;     ///<timestamp of the first lost sample
+        uint32_t samplesCount;  ///<number of lost samples per channel
+        Cause cause;
+    };
+
+    //! Rx packets handed to stream callback, valid only during the call
+    struct PacketBatch
+    {
+        int packetsCount;
+        const complex16_t* const* samples;  ///<samples of each packet, in link format range
+        const uint32_t* samplesCount;       ///<number of samples in each packet per channel
+        const uint64_t* timestamps;         ///<timestamp of the first sample of each packet
+        int channelStride;                  ///<offset of the second channel samples in joint stream packets
+    };
+    typedef std::function<void(const PacketBatch& batch)> Callback;
+
+    //! Statistics of additional Rx reader, see AttachReader()
+    typedef RingFIFO::Reader::Info ReaderInfo;
+
     StreamChannel(Streamer* streamer);
     ~StreamChannel();
 
@@ -96,8 +315,28 @@ public:
     void Close();
     int Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms = 100);
     int Write(const void* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms = 100);
+    int ReadMulti(void* const* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms = 100);
+    int WriteMulti(const void* const* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms = 100);
+    int GetChannelCount() const;
+    int AcquireReadBuffer(const complex16_t** samples, Metadata* meta, int* handle, const int32_t timeout_ms = 100);
+    int ReleaseReadBuffer(const int handle);
+    int AcquireWriteBuffer(complex16_t** samples, int* handle, const int32_t timeout_ms = 100);
+    int CommitWriteBuffer(const int handle, const uint32_t count, const Metadata* meta);
     StreamChannel::Info GetInfo();
+    int ReadBurstEvent(BurstEvent* event, const int32_t timeout_ms = 100);
+    void ReportBurst(BurstEvent::Type type, uint64_t timestamp, uint64_t time, bool dropped = false);
+    int ReadGap(Gap* gap, const int32_t timeout_ms = 100);
+    void ReportGap(uint64_t timestamp, uint32_t samplesCount, Gap::Cause cause);
+    void FlushGap();
     int GetStreamSize();
+    int AttachReader(bool dropWhenLagging);
+    int DetachReader(const int reader);
+    int ReadMultiFrom(const int reader, void* const* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms = 100);
+    int GetReaderInfo(const int reader, ReaderInfo* info);
+    int GetEventFd() const;
+    void NotifyEvent(bool force = false);
+    int SetCallback(Callback cb);
+    void RunCallback();
 
     bool IsActive() const;
     int Start();
@@ -105,11 +344,24 @@ public:
     StreamConfig config;
     Streamer* mStreamer;
     unsigned pktLost;
+    unsigned clippedSamples;
+    unsigned lateBursts;
+    uint64_t burstLead;     //!< burstLeadTime in samples
     bool mActive;
     bool used;
     RingFIFO* fifo;
+    SPSCQueue<BurstEvent>* burstEvents;
+    SPSCQueue<Gap>* gaps;
+    Gap pendingGap;             //!< Rx gap being extended by stream thread, not queued yet
+    static const int maxReaders = 8;
+    RingFIFO::Reader* readers[maxReaders];  //!< additional Rx readers, nullptr if not attached
+    int eventFd;                //!< eventfd signalled by stream thread, -1 if not used
+    uint32_t eventThreshold;    //!< samples available to signal eventFd
+    Callback callback;          //!< consumes Rx packets in stream thread if set
 protected:
-
+    template<class Source>
+    int PopConverted(Source& source, void* const* samples, const uint32_t count, uint64_t* timestamp, const int32_t timeout_ms, bool* discontinuity);
+    void DetachReaders();
 };
 
 class Streamer
@@ -132,6 +384,13 @@ public:
     std::thread txThread;
     std::atomic<bool> terminateRx;
     std::atomic<bool> terminateTx;
+    std::atomic<uint32_t> rxLinkQueueFill;
+    std::atomic<uint32_t> rxLinkQueueSize;
+    std::atomic<uint32_t> rxParseQueueFill;
+    std::atomic<uint32_t> rxParseQueuePeak;
+    std::atomic<uint32_t> rxParseQueueSize;
+    std::atomic<uint32_t> rxPacketsLost;    //!< total Rx packets lost on link, for auto-tuning
+    std::atomic<uint32_t> txPacketsLost;    //!< total Tx packets dropped by device, for auto-tuning
 
     std::vector<StreamChannel> mRxStreams;
     std::vector<StreamChannel> mTxStreams;
@@ -141,11 +400,14 @@ public:
     int streamSize;
     unsigned txBatchSize;
     unsigned rxBatchSize;
+    unsigned txLinkTransfers;   //!< Tx transfers in flight, 0 for connection default
+    unsigned rxLinkTransfers;   //!< Rx transfers in flight, 0 for connection default
     StreamConfig::StreamDataFormat dataLinkFormat;
     void ReceivePacketsLoop();
     void TransmitPacketsLoop();
 private:
     void ResizeChannelBuffers();
+    StreamConfig::StreamDataFormat SelectLinkFormat() const;
     void AlignRxTSP();
     void AlignRxRF(bool restoreValues);
     void AlignQuadrature(bool restoreValues);
@@ -22,6 +22,7 @@ struct complex16_t
 
 const int samples12InPkt = 1360;
 const int samples16InPkt = 1020;
+const int samples8InPkt = 2040;
 
 class SamplesPacket
 {
@@ -35,7 +36,16 @@ public:
         timestamp(0),
         last(0),
         flags(0),
-        samples(size ? new complex16_t[size]: nullptr)  {};
+        samples(size ? new complex16_t[size]: nullptr),
+        ownsSamples(true)  {};
+
+    //! Creates packet as a view of external storage, which is not freed by packet
+    explicit SamplesPacket(complex16_t* storage):
+        timestamp(0),
+        last(0),
+        flags(0),
+        samples(storage),
+        ownsSamples(false)  {};
 
     SamplesPacket (SamplesPacket&& pkt)
     {
@@ -43,6 +53,7 @@ public:
         last = pkt.last;
         flags = pkt.flags;
         samples = pkt.samples;
+        ownsSamples = pkt.ownsSamples;
         pkt.samples = nullptr;
     };
 
@@ -52,16 +63,19 @@ public:
         last = pkt.last;
         flags = pkt.flags;
         std::swap(samples, pkt.samples);
+        std::swap(ownsSamples, pkt.ownsSamples);
         return *this;
     }
     ~SamplesPacket()
     {
-        if (samples)
+        if (samples && ownsSamples)
             delete [] samples;
     };
 
     SamplesPacket (const SamplesPacket&) = delete;
     SamplesPacket& operator=(const SamplesPacket&) = delete;
+private:
+    bool ownsSamples;
 };
 
 }// namespace lime
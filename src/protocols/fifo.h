@@ -7,12 +7,36 @@
 #include <vector>
 #include <thread>
 #include <queue>
+#include <chrono>
 #include "dataTypes.h"
 #include <cmath>
 #include <assert.h>
+#include <new>
+#ifdef __linux__
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#endif
 
 namespace lime{
 
+/** @brief Single-producer/single-consumer ring of sample packets.
+
+    Producer owns mTail, consumer owns mHead. Indices run in range [0, 2*size)
+    so that full and empty states can be told apart for any buffer size.
+    Packets are claimed by the consumer before their samples are touched, so
+    the producer never overwrites memory that is being read. When the ring is
+    full, push_packet() evicts the oldest unclaimed packet.
+    Locks are taken only to put a side to sleep and to wake it up again.
+
+    Samples of all packets are stored in one contiguous slab with each packet
+    aligned to cache line, packets are views into it and never leave the ring.
+
+    Packets inserted with begin_push_packet() can also be read by any number of
+    additional Reader objects, each with its own read position.
+*/
 class RingFIFO
 {
 public:
@@ -29,24 +53,64 @@ public:
     {
         SYNC_TIMESTAMP = 1,
         END_BURST = 2,
+        DISCONTINUITY = 4,  ///<Rx: samples do not follow previously read samples
+    };
+
+    //! Handling of timestamp gaps between packets by pop_converted()
+    enum GapMode
+    {
+        GAP_CONCATENATE,    ///<return samples across gaps
+        GAP_ZERO_FILL,      ///<return zero samples in place of missing ones
+        GAP_SPLIT,          ///<end read at gap, next read reports discontinuity
+    };
+
+    //! Handling of packets inserted with begin_push_packet() when FIFO is full
+    enum OverflowPolicy
+    {
+        DROP_OLDEST,    ///<evict the oldest packet
+        DROP_NEWEST,    ///<drop the incoming packet
+        BLOCK,          ///<wait for space up to block timeout, then drop the incoming packet
     };
 
-    //! @brief Returns information about FIFO size and fullness
-    BufferInfo GetInfo()
+    //! Range of samples dropped by FIFO
+    struct Gap
+    {
+        uint64_t timestamp;     ///<timestamp of the first dropped sample
+        uint32_t samplesCount;  ///<number of dropped samples per channel
+    };
+
+    //! Options for samples storage allocation
+    enum MemoryFlags
+    {
+        MEM_HUGE_PAGES = 1, ///<back storage with huge pages
+        MEM_LOCK = 2,       ///<lock storage in RAM
+    };
+
+    /** @brief Returns information about FIFO size and fullness
+        @param resetCounters clear overflow and underflow counters after reading them
+    */
+    BufferInfo GetInfo(bool resetCounters = true)
     {
         BufferInfo stats;
-        std::unique_lock<std::mutex> lck(lock);
         stats.size = mBufferSize*mPktSize;
-        stats.itemsFilled = mElementsFilled*mPktSize;
-        stats.overflow = mOverflow;
-        stats.underflow = mUnderflow;
-        mOverflow = 0;
-        mUnderflow = 0;
+        stats.itemsFilled = Count(mHead.load(std::memory_order_acquire), mTail.load(std::memory_order_acquire))*mPktSize;
+        stats.overflow = resetCounters ? mOverflow.exchange(0, std::memory_order_relaxed) : mOverflow.load(std::memory_order_relaxed);
+        stats.underflow = resetCounters ? mUnderflow.exchange(0, std::memory_order_relaxed) : mUnderflow.load(std::memory_order_relaxed);
         return stats;
     }
 
+    /** @brief Returns offset between channel sample blocks in packets of joint FIFO.
+        Samples of channel N start at packet samples + N*GetChannelStride().
+    */
+    int GetChannelStride() const
+    {
+        return mPktSize;
+    }
+
     //!    @brief Initializes FIFO memory
-    RingFIFO() :  mBuffer(nullptr), mPktSize(0), mBufferSize(0)
+    RingFIFO() :  mBuffer(nullptr), mPktSize(0), mChannels(1), mBufferSize(0),
+        mSlab(nullptr), mSlabSize(0), mMemFlags(0), mMemFlagsApplied(0), mPopSlot(nullptr),
+        mGapMode(GAP_CONCATENATE), mOverflowPolicy(DROP_OLDEST), mBlockTimeout(0), mReadersWaiting(0)
     {
         Clear();
     }
@@ -55,29 +119,114 @@ public:
     {
         if (mBuffer)
             delete [] mBuffer;
+        FreeSlab();
     };
 
-    void push_packet(SamplesPacket &packet)
+    /** @brief Selects handling of timestamp gaps by pop_converted(), must be called after Resize()
+        and not while streaming. Gaps are detected between samples returned by consecutive reads,
+        samples skipped with skip_to_timestamp() or read in place are not treated as gaps.
+        Timestamps going backwards are reported as discontinuity also with GAP_ZERO_FILL.
+    */
+    void SetGapMode(GapMode mode)
+    {
+        mGapMode = mode;
+        if (mode == GAP_ZERO_FILL)
+            mZeros.assign(mChannels*mPktSize, complex16_t());
+        else
+            mZeros.clear();
+    }
+
+    /** @brief Selects handling of full FIFO by begin_push_packet(), must not be called while streaming
+        @param policy overflow policy
+        @param blockTimeout_ms longest wait for space with BLOCK policy
+    */
+    void SetOverflowPolicy(OverflowPolicy policy, uint32_t blockTimeout_ms = 0)
     {
-        std::unique_lock<std::mutex> lck(lock);
+        mOverflowPolicy = policy;
+        mBlockTimeout = blockTimeout_ms;
+    }
 
-        if (mElementsFilled >= mBufferSize) //buffer might be full, wait for free slots
+    /** @brief Gives access to the next packet for filling in place, must be called
+        only from the producer thread. Handles full FIFO according to overflow policy,
+        blocks only with BLOCK policy.
+        Packet has to be inserted with end_push_packet() before the next call.
+        @param evicted returns samples of packet evicted to make space, samplesCount is 0 if none
+        @return packet to fill, nullptr if incoming packet has to be dropped
+    */
+    SamplesPacket* begin_push_packet(Gap* evicted = nullptr)
+    {
+        const uint32_t tail = mTail.load(std::memory_order_relaxed);
+        Slot& slot = mBuffer[tail % mBufferSize];
+        if (evicted)
+            evicted->samplesCount = 0;
+        if (mOverflowPolicy != DROP_OLDEST)
         {
-                mHead = (mHead + 1) % mBufferSize;//advance to next one
-                mElementsFilled--;
-                mFirst = 0;
-                mOverflow++;
+            if (mOverflowPolicy == BLOCK && mBlockTimeout > 0 && !HasSpace(tail))
+                WaitForSpace(std::chrono::milliseconds(mBlockTimeout));
+            if (!HasSpace(tail))
+            {
+                mOverflow.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        else
+        {
+            uint32_t head = mHead.load(std::memory_order_acquire);
+            while (Count(head, tail) >= mBufferSize) //buffer is full, evict oldest packet
+            {
+                if (mHead.compare_exchange_weak(head, Next(head), std::memory_order_acq_rel, std::memory_order_acquire))
+                {
+                    mOverflow.fetch_add(1, std::memory_order_relaxed);
+                    if (evicted) //the oldest packet is in the slot being filled
+                    {
+                        evicted->timestamp = slot.pkt.timestamp;
+                        evicted->samplesCount = slot.pkt.last;
+                    }
+                    break;
+                }
+            }
+            if (Count(head, tail) < mBufferSize && slot.held.load(std::memory_order_acquire))
+            {
+                //slot is still held by consumer, drop the incoming packet instead
+                mOverflow.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
         }
+        //odd sequence tells readers that slot is being overwritten
+        slot.seq.store(2*mPushed.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return &slot.pkt;
+    }
 
-        mBuffer[mTail] = std::move(packet);
-        mTail  = (mTail + 1) % mBufferSize;//advance to next one
-        ++mElementsFilled;
+    //! @brief Inserts packet obtained with begin_push_packet() to FIFO
+    void end_push_packet()
+    {
+        const uint32_t tail = mTail.load(std::memory_order_relaxed);
+        const uint64_t pushed = mPushed.load(std::memory_order_relaxed);
+        mBuffer[tail % mBufferSize].seq.store(2*pushed+2, std::memory_order_release);
+        mPushed.store(pushed+1, std::memory_order_release);
+        mTail.store(Next(tail), std::memory_order_release);
+        NotifyConsumer();
+    }
 
-        lck.unlock();
-        hasItems.notify_one();
+    /** @brief Inserts copy of packet to FIFO, full FIFO is handled according to overflow policy.
+        Must be called only from the producer thread, blocks only with BLOCK policy.
+        @param packet packet to insert
+    */
+    void push_packet(const SamplesPacket &packet)
+    {
+        SamplesPacket* pkt = begin_push_packet();
+        if (pkt == nullptr)
+            return;
+        pkt->timestamp = packet.timestamp;
+        pkt->last = packet.last;
+        pkt->flags = packet.flags;
+        for (int ch = 0; ch < mChannels; ++ch)
+            memcpy(pkt->samples + ch*mPktSize, packet.samples + ch*mPktSize, packet.last*sizeof(complex16_t));
+        end_push_packet();
     }
 
-    /** @brief inserts samples to FIFO, operation is thread-safe
+    /** @brief inserts samples to FIFO, must be called only from the producer thread
     @param buffer pointer to array containing samples data
     @param samplesCount number of samples to insert from each buffer channel
     @param timeout_ms timeout duration for operation
@@ -87,47 +236,112 @@ public:
     uint32_t push_samples(const complex16_t *buffer, const uint32_t samplesCount, uint64_t timestamp, const uint32_t timeout_ms, const uint32_t flags)
     {
         assert(buffer != nullptr);
+        return push_converted([buffer](complex16_t* dest, uint32_t offset, int cnt){
+            memcpy(dest, &buffer[offset], cnt*sizeof(complex16_t));}, samplesCount, timestamp, timeout_ms, flags);
+    }
+
+    /** @brief inserts samples to FIFO converting them on the way, must be called only from the producer thread
+    @param copy functor called as copy(dest, srcOffset, count) for each contiguous block of packet storage,
+        dest points to the first channel, other channels follow at GetChannelStride() offsets
+    @param samplesCount number of samples to insert
+    @param timeout_ms timeout duration for operation
+    @param flags optional flags associated with the samples
+    @return number of items inserted
+    */
+    template<class CopyFunc>
+    uint32_t push_converted(CopyFunc copy, const uint32_t samplesCount, uint64_t timestamp, const uint32_t timeout_ms, const uint32_t flags)
+    {
         uint32_t samplesTaken = 0;
-        std::unique_lock<std::mutex> lck(lock);
         auto t1 = std::chrono::high_resolution_clock::now();
         while (samplesTaken < samplesCount)
         {
-            if (mElementsFilled >= mBufferSize) //buffer might be full, wait for free slots
+            const uint32_t tail = mTail.load(std::memory_order_relaxed);
+            Slot& slot = mBuffer[tail % mBufferSize];
+            if (!HasSpace(tail))
             {
                 auto elapsed = std::chrono::high_resolution_clock::now()-t1;
                 if(elapsed >= std::chrono::milliseconds(timeout_ms))
                     return samplesTaken;
-                hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms)-elapsed);
+                WaitForSpace(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::milliseconds(timeout_ms)-elapsed));
+                continue;
+            }
+            SamplesPacket& pkt = slot.pkt;
+            pkt.timestamp = timestamp + samplesTaken - mLast;
+            int cnt = samplesCount-samplesTaken;
+            if (cnt > mPktSize - mLast)
+            {
+                cnt = mPktSize - mLast;
+                pkt.flags = flags & SYNC_TIMESTAMP;
             }
             else
+                pkt.flags = flags;
+            copy(pkt.samples + mLast, samplesTaken, cnt);
+            samplesTaken+=cnt;
+            mLast += cnt;
+            pkt.last = mLast;
+            if ((mLast == mPktSize) || (pkt.flags&END_BURST))
             {
-                mBuffer[mTail].timestamp = timestamp + samplesTaken - mLast;
-                int cnt = samplesCount-samplesTaken;
-                if (cnt > mPktSize - mLast)
-                {
-                    cnt = mPktSize - mLast;
-                    mBuffer[mTail].flags = flags & SYNC_TIMESTAMP;
-                }
-                else
-                    mBuffer[mTail].flags = flags;
-                memcpy(mBuffer[mTail].samples + mLast,&buffer[samplesTaken],cnt*sizeof(complex16_t));
-                samplesTaken+=cnt;
-                mLast += cnt;
-                mBuffer[mTail].last = mLast;
-                if ((mLast == mPktSize) || (mBuffer[mTail].flags&END_BURST))
-                {
-                    mTail = (mTail+1) % mBufferSize;//advance to next one
-                    ++mElementsFilled;
-                    mLast = 0;
-                }
+                mTail.store(Next(tail), std::memory_order_release);
+                mLast = 0;
+                NotifyConsumer();
             }
         }
-        lck.unlock();
-        hasItems.notify_one();
         return samplesTaken;
     }
 
-    /** @brief Takes samples out of FIFO, operation is thread-safe
+    /** @brief Gives access to free packet storage for writing in place,
+        must be called only from the producer thread.
+        If packet was partially filled by push_samples(), remaining part of it is returned.
+        @param samples returns pointer to free samples storage
+        @param count returns number of samples that can be written
+        @param timeout_ms timeout duration for operation
+        @return handle to be passed to commit_packet(), -1 on timeout
+    */
+    int acquire_free_packet(complex16_t** samples, uint32_t* count, const uint32_t timeout_ms)
+    {
+        auto t1 = std::chrono::high_resolution_clock::now();
+        const uint32_t tail = mTail.load(std::memory_order_relaxed);
+        while (!HasSpace(tail))
+        {
+            auto elapsed = std::chrono::high_resolution_clock::now()-t1;
+            if(elapsed >= std::chrono::milliseconds(timeout_ms))
+                return -1;
+            WaitForSpace(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::milliseconds(timeout_ms)-elapsed));
+        }
+        *samples = mBuffer[tail % mBufferSize].pkt.samples + mLast;
+        *count = mPktSize - mLast;
+        return tail % mBufferSize;
+    }
+
+    /** @brief Marks samples written to storage from acquire_free_packet() as valid
+        @param handle handle returned by acquire_free_packet()
+        @param samplesCount number of samples written
+        @param timestamp timestamp of the first written sample
+        @param flags optional flags associated with the samples
+        @return number of samples committed, -1 if handle is not valid
+    */
+    int commit_packet(const int handle, uint32_t samplesCount, uint64_t timestamp, const uint32_t flags)
+    {
+        const uint32_t tail = mTail.load(std::memory_order_relaxed);
+        if (handle < 0 || (unsigned)handle != tail % mBufferSize)
+            return -1;
+        if (samplesCount > uint32_t(mPktSize - mLast))
+            samplesCount = mPktSize - mLast;
+        SamplesPacket& pkt = mBuffer[handle].pkt;
+        pkt.timestamp = timestamp - mLast;
+        pkt.flags = flags;
+        mLast += samplesCount;
+        pkt.last = mLast;
+        if ((mLast == mPktSize) || (flags&END_BURST))
+        {
+            mTail.store(Next(tail), std::memory_order_release);
+            mLast = 0;
+            NotifyConsumer();
+        }
+        return samplesCount;
+    }
+
+    /** @brief Takes samples out of FIFO, must be called only from the consumer thread
         @param buffer pointer to destination arrays for each channel samples data, each array must be big enough to contain \samplesCount number of samples.
         @param samplesCount number of samples to pop
         @param timestamp returns timestamp of the first sample in buffer
@@ -137,108 +351,840 @@ public:
     uint32_t pop_samples(complex16_t* buffer, const uint32_t samplesCount, uint64_t *timestamp, const uint32_t timeout_ms)
     {
         assert(buffer != nullptr);
+        return pop_converted([buffer](uint32_t offset, const complex16_t* src, int cnt){
+            memcpy(&buffer[offset], src, cnt*sizeof(complex16_t));}, samplesCount, timestamp, timeout_ms);
+    }
+
+    /** @brief Takes samples out of FIFO converting them on the way, must be called only from the consumer thread
+        Timestamp gaps are handled according to SetGapMode().
+        @param copy functor called as copy(destOffset, src, count) for each contiguous block of samples,
+            src points to the first channel, other channels follow at GetChannelStride() offsets
+        @param samplesCount number of samples to pop
+        @param timestamp returns timestamp of the first sample in buffer
+        @param timeout_ms timeout duration for operation
+        @param discontinuity returns true if samples do not follow previously popped samples
+        @return number of samples popped
+    */
+    template<class CopyFunc>
+    uint32_t pop_converted(CopyFunc copy, const uint32_t samplesCount, uint64_t *timestamp, const uint32_t timeout_ms, bool* discontinuity = nullptr)
+    {
         uint32_t samplesFilled = 0;
-        std::unique_lock<std::mutex> lck(lock);
+        if (discontinuity)
+            *discontinuity = false;
         while (samplesFilled < samplesCount)
         {
-            while (mElementsFilled == 0) //buffer might be empty, wait for packets
+            if (mCurrent == nullptr && (mCurrent = Claim()) == nullptr)
             {
-                if ((timeout_ms==0) || (hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms)) == std::cv_status::timeout))
+                //buffer is empty, wait for packets
+                if (!WaitForItems(timeout_ms))
                 {
-                    mUnderflow++;
+                    mUnderflow.fetch_add(1, std::memory_order_relaxed);
                     return samplesFilled;
                 }
+                continue;
+            }
+            const SamplesPacket& pkt = mCurrent->pkt;
+            const uint64_t pktTimestamp = pkt.timestamp + mFirst;
+            if (mGapMode != GAP_CONCATENATE && mNextTimestampValid && pktTimestamp != mNextTimestamp)
+            {
+                if (mGapMode == GAP_ZERO_FILL && pktTimestamp > mNextTimestamp)
+                {
+                    if(samplesFilled == 0 && timestamp != nullptr)
+                        *timestamp = mNextTimestamp;
+                    uint64_t cnt = samplesCount - samplesFilled;
+                    cnt = cnt > pktTimestamp - mNextTimestamp ? pktTimestamp - mNextTimestamp : cnt;
+                    cnt = cnt > uint64_t(mPktSize) ? mPktSize : cnt;
+                    copy(samplesFilled, mZeros.data(), cnt);
+                    samplesFilled += cnt;
+                    mNextTimestamp += cnt;
+                    continue;
+                }
+                if (samplesFilled > 0) //end read at gap
+                    return samplesFilled;
+                if (discontinuity)
+                    *discontinuity = true;
             }
             if(samplesFilled == 0 && timestamp != nullptr)
-                *timestamp = mBuffer[mHead].timestamp + mFirst;
+                *timestamp = pktTimestamp;
 
-            while(mElementsFilled > 0 && samplesFilled < samplesCount)
-            {
-                int cnt = samplesCount - samplesFilled;
-                const int cntbuf = mBuffer[mHead].last - mFirst;
-                cnt = cnt > cntbuf ? cntbuf : cnt;
+            int cnt = samplesCount - samplesFilled;
+            const int cntbuf = pkt.last - mFirst;
+            cnt = cnt > cntbuf ? cntbuf : cnt;
 
-                memcpy(&buffer[samplesFilled],&mBuffer[mHead].samples[mFirst],cnt*sizeof(complex16_t));
-                samplesFilled += cnt;
+            copy(samplesFilled, &pkt.samples[mFirst], cnt);
+            samplesFilled += cnt;
+            mNextTimestamp = pktTimestamp + cnt;
+            mNextTimestampValid = true;
 
-                if (cntbuf == cnt) //packet depleated
+            if (cntbuf == cnt) //packet depleated
+            {
+                Release(mCurrent);
+                mCurrent = nullptr;
+                mFirst = 0;
+            }
+            else
+                mFirst += cnt;
+        }
+        return samplesFilled;
+    }
+
+    /** @brief Drops samples older than given timestamp without copying them, must be called only
+        from the consumer thread. Packets ending before timestamp are released whole, packet
+        containing timestamp is trimmed, so that next popped sample is the requested one.
+        @param timestamp timestamp of the first sample to keep
+        @param timeout_ms timeout duration for waiting for each packet
+        @return true if FIFO is positioned at or after timestamp, false on timeout
+    */
+    bool skip_to_timestamp(const uint64_t timestamp, const uint32_t timeout_ms)
+    {
+        while (true)
+        {
+            if (mCurrent == nullptr && (mCurrent = Claim()) == nullptr)
+            {
+                if (!WaitForItems(timeout_ms))
                 {
-                    mHead = (mHead + 1) % mBufferSize;//advance to next one
-                    mFirst = 0;
-                    --mElementsFilled;
+                    mUnderflow.fetch_add(1, std::memory_order_relaxed);
+                    return false;
                 }
-                else
-                    mFirst += cnt;
+                continue;
+            }
+            const SamplesPacket& pkt = mCurrent->pkt;
+            if (pkt.timestamp + mFirst >= timestamp)
+                return true;
+            mNextTimestampValid = false; //skipped samples are not a gap
+            if (pkt.timestamp + pkt.last > timestamp)
+            {
+                mFirst = timestamp - pkt.timestamp;
+                return true;
             }
+            Release(mCurrent);
+            mCurrent = nullptr;
+            mFirst = 0;
         }
-        lck.unlock();
-        hasItems.notify_one();
-        return samplesFilled;
     }
 
+    /** @brief Claims the oldest whole packet for reading in place, must be called only
+        from the consumer thread. Packet stays owned by the caller until end_pop_packet() is called.
+        @param timeout_ms timeout duration for operation
+        @return claimed packet, nullptr on timeout
+    */
+    SamplesPacket* begin_pop_packet(const uint32_t timeout_ms)
+    {
+        assert(mPopSlot == nullptr);
+        while ((mPopSlot = Claim()) == nullptr) //buffer might be empty, wait for packets
+            if (!WaitForItems(timeout_ms))
+            {
+                mUnderflow.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        return &mPopSlot->pkt;
+    }
+
+    //! @brief Returns packet obtained with begin_pop_packet() back to FIFO
+    void end_pop_packet()
+    {
+        Release(mPopSlot);
+        mPopSlot = nullptr;
+    }
+
+    /** @brief Takes copy of whole packet out of FIFO, must be called only from the consumer thread
+        @param packet destination packet, must have storage for FIFO packet size times channels count
+    */
     void pop_packet(SamplesPacket &packet)
     {
-        std::unique_lock<std::mutex> lck(lock);
+        const SamplesPacket* pkt = begin_pop_packet(100);
+        if (pkt == nullptr)
+        {
+            packet.last = 0;
+            packet.flags = 0;
+            return;
+        }
+        packet.timestamp = pkt->timestamp;
+        packet.last = pkt->last;
+        packet.flags = pkt->flags;
+        for (int ch = 0; ch < mChannels; ++ch)
+            memcpy(packet.samples + ch*mPktSize, pkt->samples + ch*mPktSize, pkt->last*sizeof(complex16_t));
+        end_pop_packet();
+    }
 
-        while (mElementsFilled == 0) //buffer might be empty, wait for packets
-            if (hasItems.wait_for(lck, std::chrono::milliseconds(100)) == std::cv_status::timeout)
+    /** @brief Claims packet for reading in place, must be called only from the consumer thread
+        Packet stays owned by the caller until release_packet() is called,
+        producer does not overwrite it meanwhile.
+        @param samples returns pointer to the first unread sample of the packet
+        @param count returns number of samples available at samples pointer
+        @param timestamp returns timestamp of the first sample
+        @param timeout_ms timeout duration for operation
+        @return handle of claimed packet, -1 on timeout
+    */
+    int acquire_packet(const complex16_t** samples, uint32_t* count, uint64_t* timestamp, const uint32_t timeout_ms)
+    {
+        Slot* slot = mCurrent;
+        int first = mFirst;
+        mCurrent = nullptr;
+        mFirst = 0;
+        while (slot == nullptr && (slot = Claim()) == nullptr) //buffer might be empty, wait for packets
+            if (!WaitForItems(timeout_ms))
             {
-                mUnderflow++;
-                packet.last = 0;
-                packet.flags = 0;
-                return;
+                mUnderflow.fetch_add(1, std::memory_order_relaxed);
+                return -1;
             }
+        *samples = slot->pkt.samples + first;
+        *count = slot->pkt.last - first;
+        mNextTimestampValid = false;
+        if (timestamp != nullptr)
+            *timestamp = slot->pkt.timestamp + first;
+        return slot - mBuffer;
+    }
 
-        packet = std::move(mBuffer[mHead]);
-        mHead = (mHead + 1) % mBufferSize;//advance to next one
-        --mElementsFilled;
-        lck.unlock();
-        hasItems.notify_one();
+    /** @brief Returns packet claimed with acquire_packet() back to FIFO
+        @param handle packet handle returned by acquire_packet()
+        @return 0 on success, -1 if handle is not valid
+    */
+    int release_packet(const int handle)
+    {
+        if (handle < 0 || (unsigned)handle >= mBufferSize || !mBuffer[handle].held.load(std::memory_order_relaxed))
+            return -1;
+        Release(&mBuffer[handle]);
+        return 0;
     }
 
-    void Resize(int pktSize, int bufSize = -1)
+    /** @brief Claims available whole packets for reading in place without waiting, must be
+        called only from the consumer thread. Packets stay owned by the caller until
+        release_packet() is called for each of them.
+        @param packets returns claimed packets, oldest first
+        @param handles returns packet handles
+        @param maxCount maximum number of packets to claim
+        @return number of claimed packets
+    */
+    int acquire_packets(const SamplesPacket** packets, int* handles, const int maxCount)
+    {
+        int count = 0;
+        Slot* slot;
+        while (count < maxCount && (slot = Claim()) != nullptr)
+        {
+            packets[count] = &slot->pkt;
+            handles[count] = slot - mBuffer;
+            ++count;
+        }
+        return count;
+    }
+
+    /** @brief Additional consumer of FIFO packets with its own read position.
+        Reader never holds packets, so it can not stall the producer: samples are
+        copied out of packet and then checked against packet sequence number,
+        samples of packet that was overwritten meanwhile are discarded as lost.
+        Reader only sees packets inserted with begin_push_packet() or push_packet(),
+        it must be used from one thread and must not outlive FIFO.
+    */
+    class Reader
+    {
+    public:
+        //! Handling of reader that falls more than FIFO size behind the producer
+        enum LagPolicy
+        {
+            LAG_SKIP,   ///<count lost packets and continue from the oldest available one
+            LAG_DETACH, ///<drop reader, reads return nothing until Reset()
+        };
+
+        struct Info
+        {
+            uint32_t lag;       ///<samples waiting to be read
+            uint32_t lagPeak;   ///<largest lag since last GetInfo()
+            uint32_t overflow;  ///<packets lost due to lagging
+            uint32_t underflow;
+            bool detached;
+        };
+
+        //! @brief Creates reader that starts with the next packet inserted to FIFO
+        Reader(RingFIFO* fifo, LagPolicy policy) : mFifo(fifo), mPolicy(policy),
+            mNext(fifo->mPushed.load(std::memory_order_acquire)), mFirst(0), mLost(false),
+            mLag(0), mLagPeak(0), mOverflow(0), mUnderflow(0), mDetached(false)
+        {
+        }
+
+        /** @brief Returns reader statistics
+            @param resetCounters clear lag peak, overflow and underflow counters after reading them
+        */
+        Info GetInfo(bool resetCounters = true)
+        {
+            Info info;
+            info.lag = mLag.load(std::memory_order_relaxed);
+            info.lagPeak = resetCounters ? mLagPeak.exchange(0, std::memory_order_relaxed) : mLagPeak.load(std::memory_order_relaxed);
+            info.overflow = resetCounters ? mOverflow.exchange(0, std::memory_order_relaxed) : mOverflow.load(std::memory_order_relaxed);
+            info.underflow = resetCounters ? mUnderflow.exchange(0, std::memory_order_relaxed) : mUnderflow.load(std::memory_order_relaxed);
+            info.detached = mDetached.load(std::memory_order_relaxed);
+            return info;
+        }
+
+        //! @brief Returns true if reader was dropped for lagging behind
+        bool IsDetached() const
+        {
+            return mDetached.load(std::memory_order_relaxed);
+        }
+
+        //! @brief Attaches reader again, continuing with the next packet inserted to FIFO
+        void Reset()
+        {
+            mNext = mFifo->mPushed.load(std::memory_order_acquire);
+            mFirst = 0;
+            mDetached.store(false, std::memory_order_relaxed);
+        }
+
+        /** @brief Reads samples converting them on the way, same as RingFIFO::pop_converted().
+            Returned samples are always contiguous, read stops early when packets were lost,
+            next read reports discontinuity then. FIFO gap mode does not apply to readers.
+            @return number of samples read
+        */
+        template<class CopyFunc>
+        uint32_t pop_converted(CopyFunc copy, const uint32_t samplesCount, uint64_t *timestamp, const uint32_t timeout_ms, bool* discontinuity = nullptr)
+        {
+            uint32_t samplesFilled = 0;
+            if (discontinuity)
+                *discontinuity = false;
+            while (samplesFilled < samplesCount && !IsDetached())
+            {
+                const uint64_t pushed = mFifo->mPushed.load(std::memory_order_acquire);
+                if (mNext > pushed) //FIFO was cleared
+                {
+                    mNext = pushed;
+                    mFirst = 0;
+                }
+                if (mNext == pushed)
+                {
+                    if (!mFifo->WaitForPacket(mNext, timeout_ms))
+                    {
+                        mUnderflow.fetch_add(1, std::memory_order_relaxed);
+                        break;
+                    }
+                    continue;
+                }
+                Slot& slot = mFifo->mBuffer[mNext % mFifo->mBufferSize];
+                const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+                const SamplesPacket& pkt = slot.pkt;
+                const uint64_t pktTimestamp = pkt.timestamp;
+                const int cntbuf = int(pkt.last) - mFirst;
+                int cnt = samplesCount - samplesFilled;
+                cnt = cnt > cntbuf ? cntbuf : cnt;
+                if (seq == 2*mNext+2 && cnt > 0)
+                    copy(samplesFilled, &pkt.samples[mFirst], cnt);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq != 2*mNext+2 || slot.seq.load(std::memory_order_relaxed) != seq)
+                {
+                    //packet was overwritten, samples copied from it are not valid
+                    Lagged();
+                    if (samplesFilled > 0)
+                        break;
+                    continue;
+                }
+                if (samplesFilled == 0)
+                {
+                    if (timestamp != nullptr)
+                        *timestamp = pktTimestamp + mFirst;
+                    if (discontinuity != nullptr)
+                        *discontinuity = mLost;
+                    mLost = false;
+                }
+                if (cnt < 0)
+                    cnt = 0;
+                samplesFilled += cnt;
+                if (cntbuf == cnt) //packet depleted
+                {
+                    ++mNext;
+                    mFirst = 0;
+                }
+                else
+                    mFirst += cnt;
+                UpdateLag(pushed);
+            }
+            return samplesFilled;
+        }
+
+    private:
+        void Lagged()
+        {
+            const uint64_t pushed = mFifo->mPushed.load(std::memory_order_acquire);
+            //slot of the oldest packet might already be overwritten by the next one
+            const uint64_t oldest = pushed >= mFifo->mBufferSize ? pushed - mFifo->mBufferSize + 1 : 0;
+            const uint64_t next = mNext < oldest ? oldest : mNext + 1;
+            mOverflow.fetch_add(next - mNext, std::memory_order_relaxed);
+            mNext = next;
+            mFirst = 0;
+            mLost = true;
+            if (mPolicy == LAG_DETACH)
+                mDetached.store(true, std::memory_order_relaxed);
+        }
+
+        void UpdateLag(uint64_t pushed)
+        {
+            const uint32_t lag = (pushed > mNext ? pushed - mNext : 0)*mFifo->mPktSize - mFirst;
+            mLag.store(lag, std::memory_order_relaxed);
+            if (lag > mLagPeak.load(std::memory_order_relaxed))
+                mLagPeak.store(lag, std::memory_order_relaxed);
+        }
+
+        RingFIFO* mFifo;
+        const LagPolicy mPolicy;
+        uint64_t mNext; //number of the next packet to read
+        int32_t mFirst;
+        bool mLost;     //packets were lost after the last read sample
+        std::atomic<uint32_t> mLag;
+        std::atomic<uint32_t> mLagPeak;
+        std::atomic<uint32_t> mOverflow;
+        std::atomic<uint32_t> mUnderflow;
+        std::atomic<bool> mDetached;
+    };
+
+    /** @brief Reallocates FIFO storage, must not be called while streaming
+        @param pktSize number of samples in packet per channel
+        @param bufSize number of packets, -1 to keep the same total number of samples
+        @param memFlags requested MemoryFlags, -1 to keep previously requested
+        @param channels number of channels stored together in each packet, -1 to keep previous
+        @return MemoryFlags that are in effect
+    */
+    uint32_t Resize(int pktSize, int bufSize = -1, int memFlags = -1, int channels = -1)
     {
         Clear();
-        std::unique_lock<std::mutex> lck(lock);
         if (bufSize < 0)
            bufSize =  mPktSize*mBufferSize/pktSize;
+        if (memFlags < 0)
+            memFlags = mMemFlags;
+        if (channels < 0)
+            channels = mChannels;
 
-        if ((unsigned)bufSize == mBufferSize && pktSize == mPktSize)
-            return;
+        if ((unsigned)bufSize == mBufferSize && pktSize == mPktSize && (uint32_t)memFlags == mMemFlags && channels == mChannels)
+            return mMemFlagsApplied;
         mBufferSize = bufSize;
         mPktSize = pktSize;
+        mMemFlags = memFlags;
+        mChannels = channels;
         if (mBuffer)
             delete [] mBuffer;
+        FreeSlab();
+        mBuffer = nullptr;
+        if (bufSize == 0)
+            return 0;
 
-        mBuffer = bufSize == 0 ? nullptr : new SamplesPacket[mBufferSize];
+        //round packets up to cache line, so that they do not share lines
+        const size_t stride = (mChannels*mPktSize*sizeof(complex16_t) + cacheLineSize - 1) / cacheLineSize * cacheLineSize;
+        AllocateSlab(stride*mBufferSize);
+        mBuffer = new Slot[mBufferSize];
         for (unsigned i = 0; i < mBufferSize; i++)
-            mBuffer[i] = SamplesPacket(mPktSize);
+            mBuffer[i].pkt = SamplesPacket((complex16_t*)(mSlab + i*stride));
+        return mMemFlagsApplied;
     }
 
+    //! @brief Resets FIFO to empty state, must not be called while streaming
     void Clear()
     {
-        std::unique_lock<std::mutex> lck(lock);
-        mHead = 0;
-        mTail = 0;
+        mHead.store(0, std::memory_order_relaxed);
+        mTail.store(0, std::memory_order_relaxed);
         mFirst = 0;
         mLast = 0;
-        mElementsFilled = 0;
-        mOverflow = 0;
-        mUnderflow = 0;
+        mCurrent = nullptr;
+        mPopSlot = nullptr;
+        mNextTimestampValid = false;
+        mOverflow.store(0, std::memory_order_relaxed);
+        mUnderflow.store(0, std::memory_order_relaxed);
+        mPushed.store(0, std::memory_order_relaxed);
+        mConsumerWaiting.store(false, std::memory_order_relaxed);
+        mProducerWaiting.store(false, std::memory_order_relaxed);
+        for (unsigned i = 0; i < mBufferSize; i++)
+        {
+            mBuffer[i].held.store(false, std::memory_order_relaxed);
+            mBuffer[i].seq.store(0, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
     }
 
 protected:
-    SamplesPacket* mBuffer;
+    struct Slot
+    {
+        Slot() : held(false), seq(0) {};
+        SamplesPacket pkt;
+        std::atomic<bool> held; //packet is being read by consumer
+        std::atomic<uint64_t> seq; //2*(packet number+1) when written, odd while being written
+    };
+
+    static const int cacheLineSize = 64;
+
+    void AllocateSlab(size_t size)
+    {
+        mMemFlagsApplied = 0;
+#ifdef __linux__
+        void* mem = MAP_FAILED;
+        if (mMemFlags & MEM_HUGE_PAGES)
+        {
+            const size_t hugePageSize = 2*1024*1024;
+            mSlabSize = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+            mem = mmap(nullptr, mSlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mem != MAP_FAILED)
+                mMemFlagsApplied |= MEM_HUGE_PAGES;
+        }
+        if (mem == MAP_FAILED)
+        {
+            //regular pages, ask for transparent huge pages if reserved ones are not available
+            mSlabSize = size;
+            mem = mmap(nullptr, mSlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED)
+                throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+            if ((mMemFlags & MEM_HUGE_PAGES) && madvise(mem, mSlabSize, MADV_HUGEPAGE) == 0)
+                mMemFlagsApplied |= MEM_HUGE_PAGES;
+#endif
+        }
+        if ((mMemFlags & MEM_LOCK) && mlock(mem, mSlabSize) == 0)
+            mMemFlagsApplied |= MEM_LOCK;
+        mSlab = (char*)mem;
+#else
+        mSlabSize = size;
+#ifdef _WIN32
+        mSlab = (char*)_aligned_malloc(size, cacheLineSize);
+#else
+        void* mem = nullptr;
+        mSlab = posix_memalign(&mem, cacheLineSize, size) == 0 ? (char*)mem : nullptr;
+#endif
+        if (mSlab == nullptr)
+            throw std::bad_alloc();
+#endif
+    }
+
+    void FreeSlab()
+    {
+        if (mSlab == nullptr)
+            return;
+#ifdef __linux__
+        munmap(mSlab, mSlabSize); //also unlocks memory
+#elif defined(_WIN32)
+        _aligned_free(mSlab);
+#else
+        free(mSlab);
+#endif
+        mSlab = nullptr;
+        mSlabSize = 0;
+        mMemFlagsApplied = 0;
+    }
+
+    uint32_t Next(uint32_t index) const
+    {
+        return index + 1 == 2*mBufferSize ? 0 : index + 1;
+    }
+
+    uint32_t Count(uint32_t head, uint32_t tail) const
+    {
+        return tail >= head ? tail - head : tail + 2*mBufferSize - head;
+    }
+
+    //! @brief Checks if producer can write to slot at tail index
+    bool HasSpace(uint32_t tail) const
+    {
+        return Count(mHead.load(std::memory_order_acquire), tail) < mBufferSize
+            && !mBuffer[tail % mBufferSize].held.load(std::memory_order_acquire);
+    }
+
+    //! @brief Claims the oldest packet for reading, returns nullptr if FIFO is empty
+    Slot* Claim()
+    {
+        uint32_t head = mHead.load(std::memory_order_acquire);
+        while (head != mTail.load(std::memory_order_acquire))
+        {
+            Slot* slot = &mBuffer[head % mBufferSize];
+            slot->held.store(true, std::memory_order_seq_cst);
+            if (mHead.compare_exchange_strong(head, Next(head), std::memory_order_seq_cst, std::memory_order_acquire))
+                return slot;
+            slot->held.store(false, std::memory_order_release); //evicted by producer, retry
+        }
+        return nullptr;
+    }
+
+    //! @brief Returns claimed packet slot back to producer
+    void Release(Slot* slot)
+    {
+        slot->held.store(false, std::memory_order_release);
+        NotifyProducer();
+    }
+
+    bool WaitForItems(uint32_t timeout_ms)
+    {
+        if (timeout_ms == 0)
+            return false;
+        std::unique_lock<std::mutex> lck(mWaitLock);
+        mConsumerWaiting.store(true, std::memory_order_seq_cst);
+        bool ready = hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms), [this]{
+            return mHead.load(std::memory_order_seq_cst) != mTail.load(std::memory_order_seq_cst);});
+        mConsumerWaiting.store(false, std::memory_order_relaxed);
+        return ready;
+    }
+
+    void WaitForSpace(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lck(mWaitLock);
+        mProducerWaiting.store(true, std::memory_order_seq_cst);
+        hasSpace.wait_for(lck, timeout, [this]{
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return HasSpace(mTail.load(std::memory_order_relaxed));});
+        mProducerWaiting.store(false, std::memory_order_relaxed);
+    }
+
+    void NotifyConsumer()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mConsumerWaiting.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lck(mWaitLock);
+            hasItems.notify_one();
+        }
+        if (mReadersWaiting.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard<std::mutex> lck(mWaitLock);
+            hasPackets.notify_all();
+        }
+    }
+
+    //! @brief Waits until packet number next is inserted, used by readers
+    bool WaitForPacket(uint64_t next, uint32_t timeout_ms)
+    {
+        if (timeout_ms == 0)
+            return false;
+        std::unique_lock<std::mutex> lck(mWaitLock);
+        mReadersWaiting.fetch_add(1, std::memory_order_seq_cst);
+        bool ready = hasPackets.wait_for(lck, std::chrono::milliseconds(timeout_ms), [this, next]{
+            return mPushed.load(std::memory_order_seq_cst) != next;});
+        mReadersWaiting.fetch_sub(1, std::memory_order_relaxed);
+        return ready;
+    }
+
+    void NotifyProducer()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mProducerWaiting.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lck(mWaitLock);
+            hasSpace.notify_one();
+        }
+    }
+
+    Slot* mBuffer;
     int32_t mPktSize;
+    int32_t mChannels;
     uint32_t mBufferSize;
-    uint32_t mHead;
-    uint32_t mTail;
+    char* mSlab;
+    size_t mSlabSize;
+    uint32_t mMemFlags;
+    uint32_t mMemFlagsApplied;
+
+    //consumer side
+    char pad0[cacheLineSize];
+    std::atomic<uint32_t> mHead;
+    Slot* mCurrent;
+    Slot* mPopSlot;
     int32_t mFirst;
+    std::atomic<uint32_t> mUnderflow;
+    std::atomic<bool> mConsumerWaiting;
+    GapMode mGapMode;
+    uint64_t mNextTimestamp;    //timestamp following the last popped sample
+    bool mNextTimestampValid;
+    std::vector<complex16_t> mZeros;
+
+    //producer side
+    char pad1[cacheLineSize];
+    std::atomic<uint32_t> mTail;
     int32_t mLast;
-    uint32_t mElementsFilled;
-    uint32_t mOverflow;
-    uint32_t mUnderflow;
-    std::mutex lock;
+    std::atomic<uint32_t> mOverflow;
+    std::atomic<bool> mProducerWaiting;
+    std::atomic<uint64_t> mPushed; //packets inserted with end_push_packet()
+    OverflowPolicy mOverflowPolicy;
+    uint32_t mBlockTimeout;
+    char pad2[cacheLineSize];
+
+    std::atomic<int> mReadersWaiting;
+    std::mutex mWaitLock;
+    std::condition_variable hasItems;
+    std::condition_variable hasSpace;
+    std::condition_variable hasPackets;
+};
+
+/** @brief Bounded single-producer/single-consumer queue of small items.
+    Push never blocks, pop can wait for items with a timeout.
+*/
+template<class T>
+class SPSCQueue
+{
+public:
+    SPSCQueue(uint32_t capacity) : mItems(capacity+1), mHead(0), mTail(0), mConsumerWaiting(false)
+    {
+    }
+
+    uint32_t capacity() const
+    {
+        return mItems.size()-1;
+    }
+
+    //! @brief Returns number of queued items
+    uint32_t size() const
+    {
+        const uint32_t head = mHead.load(std::memory_order_acquire);
+        const uint32_t tail = mTail.load(std::memory_order_acquire);
+        return (tail + mItems.size() - head) % mItems.size();
+    }
+
+    /** @brief Adds item to queue, must be called only from the producer thread
+        @return false if queue is full
+    */
+    bool push(const T& item)
+    {
+        const uint32_t tail = mTail.load(std::memory_order_relaxed);
+        const uint32_t next = (tail + 1) % mItems.size();
+        if (next == mHead.load(std::memory_order_acquire))
+            return false;
+        mItems[tail] = item;
+        mTail.store(next, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mConsumerWaiting.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lck(mWaitLock);
+            hasItems.notify_one();
+        }
+        return true;
+    }
+
+    /** @brief Takes item from queue, must be called only from the consumer thread
+        @param item returns taken item
+        @param timeout_ms timeout duration to wait for items, 0 to return immediately
+        @return false if queue is empty
+    */
+    bool pop(T& item, const uint32_t timeout_ms)
+    {
+        const uint32_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire))
+        {
+            if (timeout_ms == 0)
+                return false;
+            std::unique_lock<std::mutex> lck(mWaitLock);
+            mConsumerWaiting.store(true, std::memory_order_seq_cst);
+            bool ready = hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms), [this, head]{
+                return head != mTail.load(std::memory_order_seq_cst);});
+            mConsumerWaiting.store(false, std::memory_order_relaxed);
+            if (!ready)
+                return false;
+        }
+        item = mItems[head];
+        mHead.store((head + 1) % mItems.size(), std::memory_order_release);
+        return true;
+    }
+
+protected:
+    static const int cacheLineSize = 64;
+    std::vector<T> mItems;
+    char pad0[cacheLineSize];
+    std::atomic<uint32_t> mHead;
+    char pad1[cacheLineSize];
+    std::atomic<uint32_t> mTail;
+    char pad2[cacheLineSize];
+    std::atomic<bool> mConsumerWaiting;
+    std::mutex mWaitLock;
+    std::condition_variable hasItems;
+};
+
+/** @brief Bounded multi-producer/single-consumer queue of small items.
+    Producers claim cells with compare-and-swap, each cell has sequence number
+    telling whether it is free for position or holds item of position.
+    Push never blocks, pop can wait for items with a timeout.
+*/
+template<class T>
+class MPSCQueue
+{
+public:
+    MPSCQueue(uint32_t capacity) : mCells(capacity), mHead(0), mTail(0), mConsumerWaiting(false)
+    {
+        for (uint32_t i = 0; i < capacity; ++i)
+            mCells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    uint32_t capacity() const
+    {
+        return mCells.size();
+    }
+
+    //! @brief Returns number of queued items, including ones being pushed
+    uint32_t size() const
+    {
+        return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+    }
+
+    /** @brief Adds item to queue, can be called from any thread
+        @return false if queue is full
+    */
+    bool push(const T& item)
+    {
+        uint64_t pos = mTail.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &mCells[pos % mCells.size()];
+            const uint64_t seq = cell->seq.load(std::memory_order_acquire);
+            if (seq == pos)
+            {
+                if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (seq < pos)
+                return false;
+            else
+                pos = mTail.load(std::memory_order_relaxed);
+        }
+        cell->item = item;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mConsumerWaiting.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lck(mWaitLock);
+            hasItems.notify_one();
+        }
+        return true;
+    }
+
+    /** @brief Takes item from queue, must be called only from the consumer thread
+        @param item returns taken item
+        @param timeout_ms timeout duration to wait for items, 0 to return immediately
+        @return false if queue is empty
+    */
+    bool pop(T& item, const uint32_t timeout_ms)
+    {
+        const uint64_t head = mHead.load(std::memory_order_relaxed);
+        Cell& cell = mCells[head % mCells.size()];
+        if (cell.seq.load(std::memory_order_acquire) != head + 1)
+        {
+            if (timeout_ms == 0)
+                return false;
+            std::unique_lock<std::mutex> lck(mWaitLock);
+            mConsumerWaiting.store(true, std::memory_order_seq_cst);
+            bool ready = hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms), [&cell, head]{
+                return cell.seq.load(std::memory_order_seq_cst) == head + 1;});
+            mConsumerWaiting.store(false, std::memory_order_relaxed);
+            if (!ready)
+                return false;
+        }
+        item = cell.item;
+        cell.seq.store(head + mCells.size(), std::memory_order_release);
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+protected:
+    static const int cacheLineSize = 64;
+    struct Cell
+    {
+        std::atomic<uint64_t> seq;
+        T item;
+    };
+    std::vector<Cell> mCells;
+    char pad0[cacheLineSize];
+    std::atomic<uint64_t> mHead;
+    char pad1[cacheLineSize];
+    std::atomic<uint64_t> mTail;
+    char pad2[cacheLineSize];
+    std::atomic<bool> mConsumerWaiting;
+    std::mutex mWaitLock;
     std::condition_variable hasItems;
 };
 